@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Microbenchmark for simd_fill() against the byte loop padding() used to
+// fill its buffer with, for 1 to 4 byte padding characters.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "simd.h"
+
+// Bytes filled per measurement
+#define TOTAL (1UL << 30)
+
+static const char *chars[] = { " ", "é", "᪥", "😀" };
+
+/**
+ * fill_loop() - The loop padding() used before simd_fill()
+ */
+static void fill_loop(char *s, size_t size, const char *tmp, size_t tmp_len)
+{
+	for (size_t i = 0; i < size; i += tmp_len)
+		for (size_t j = 0; j < tmp_len; ++j)
+			s[i + j] = tmp[j];
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * bench() - Fill @buf over and over until TOTAL bytes are written
+ *
+ * Returns: Throughput in GB/s
+ */
+static double bench(void (*fill)(char *, size_t, const char *, size_t),
+		    char *buf, size_t len, const char *c)
+{
+	size_t clen = strlen(c);
+	size_t bytes = len - len % clen;
+	double start = now();
+
+	for (size_t done = 0; done < TOTAL; done += bytes) {
+		fill(buf, bytes, c, clen);
+		// Keep the compiler from dropping the stores
+		__asm__ __volatile__("" : : "r"(buf) : "memory");
+	}
+
+	return TOTAL / (now() - start) / 1e9;
+}
+
+int main(void)
+{
+	size_t sizes[] = { 80, 4096, 64 << 10, 16 << 20 };
+	char *buf = malloc(16 << 20);
+
+	if (!buf)
+		return 1;
+
+	printf("kernels: %s\n", simd_name());
+	printf("%10s %5s %10s %10s %8s\n", "bytes", "width", "loop GB/s",
+	       "simd GB/s", "speedup");
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		for (size_t j = 0; j < sizeof(chars) / sizeof(chars[0]); ++j) {
+			double loop = bench(fill_loop, buf, sizes[i], chars[j]);
+			double simd = bench(simd_fill, buf, sizes[i], chars[j]);
+
+			printf("%10zu %5zu %10.2f %10.2f %7.1fx\n", sizes[i],
+			       strlen(chars[j]), loop, simd, simd / loop);
+		}
+	}
+
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,192 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Load generator for pad --serve. Sends requests one at a time, which is
+// what a shell coproc does, and in batches, and reports requests per second.
+//
+//	bench-serve [SOCKET]
+//
+// Without SOCKET it starts ./pad --serve itself and talks to it through
+// pipes, with SOCKET it connects to a running pad --serve --socket SOCKET.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "padding.h"
+#include "serve.h"
+
+// Requests per measurement
+#define REQUESTS 200000
+// Requests sent before reading their responses
+#define BATCH 64
+
+#define STRING "String※"
+#define CHAR "᪥"
+#define SIZE 25
+// STRING padded to SIZE with CHAR
+#define EXPECTED (sizeof(STRING) - 1 + (SIZE - 7) * (sizeof(CHAR) - 1))
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void put_u32(unsigned char *p, unsigned int v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+static unsigned int get_u32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static void xwrite(int fd, const void *buf, size_t len)
+{
+	for (size_t done = 0; done < len;) {
+		ssize_t n = write(fd, (const char *)buf + done, len - done);
+
+		if (n <= 0) {
+			perror("bench-serve");
+			exit(1);
+		}
+		done += n;
+	}
+}
+
+static void xread(int fd, void *buf, size_t len)
+{
+	for (size_t done = 0; done < len;) {
+		ssize_t n = read(fd, (char *)buf + done, len - done);
+
+		if (n <= 0) {
+			fprintf(stderr, "bench-serve: server went away\n");
+			exit(1);
+		}
+		done += n;
+	}
+}
+
+/**
+ * request() - Encode a request, see serve.h
+ *
+ * Returns: Size of the request in bytes
+ */
+static size_t request(unsigned char *buf)
+{
+	size_t clen = sizeof(CHAR) - 1;
+	size_t len = sizeof(STRING) - 1;
+
+	put_u32(buf, len);
+	put_u32(buf + 4, SIZE);
+	buf[8] = MODE_LEFT;
+	buf[9] = clen;
+	buf[10] = 0;
+	buf[11] = 0;
+	memcpy(buf + SERVE_REQUEST, CHAR, clen);
+	memcpy(buf + SERVE_REQUEST + clen, STRING, len);
+
+	return SERVE_REQUEST + clen + len;
+}
+
+/**
+ * bench() - Send REQUESTS requests, @batch at a time
+ *
+ * Returns: Requests per second
+ */
+static double bench(int in, int out, int batch)
+{
+	static unsigned char req[BATCH * 64];
+	static unsigned char resp[BATCH * (SERVE_RESPONSE + EXPECTED)];
+	size_t len = 0;
+
+	for (int i = 0; i < batch; ++i)
+		len += request(req + len);
+
+	double start = now();
+
+	for (int done = 0; done < REQUESTS; done += batch) {
+		xwrite(out, req, len);
+		xread(in, resp, batch * (SERVE_RESPONSE + EXPECTED));
+	}
+
+	double rps = REQUESTS / (now() - start);
+
+	if (get_u32(resp) != EXPECTED || get_u32(resp + 4) != SERVE_OK) {
+		fprintf(stderr, "bench-serve: unexpected response\n");
+		exit(1);
+	}
+
+	return rps;
+}
+
+int main(int argc, char **argv)
+{
+	int in, out;
+	pid_t pid = 0;
+
+	if (argc > 1) {
+		struct sockaddr_un addr = { .sun_family = AF_UNIX };
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+		if (fd < 0 ||
+		    connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+			perror("bench-serve");
+			return 1;
+		}
+
+		in = out = fd;
+		printf("pad --serve on %s\n", argv[1]);
+	} else {
+		int to[2], from[2];
+
+		if (pipe(to) || pipe(from) || (pid = fork()) < 0) {
+			perror("bench-serve");
+			return 1;
+		}
+
+		if (!pid) {
+			dup2(to[0], STDIN_FILENO);
+			dup2(from[1], STDOUT_FILENO);
+			close(to[0]);
+			close(to[1]);
+			close(from[0]);
+			close(from[1]);
+			execl("./pad", "pad", "--serve", (char *)NULL);
+			perror("bench-serve - ./pad");
+			_exit(127);
+		}
+
+		close(to[0]);
+		close(from[1]);
+		out = to[1];
+		in = from[0];
+		printf("pad --serve over pipes\n");
+	}
+
+	double rps = bench(in, out, 1);
+
+	printf("one at a time: %10.0f req/s, %6.2f us/req\n", rps, 1e6 / rps);
+	printf("batches of %2d: %10.0f req/s\n", BATCH, bench(in, out, BATCH));
+
+	close(out);
+	if (in != out)
+		close(in);
+	if (pid)
+		waitpid(pid, NULL, 0);
+
+	return 0;
+}
@@ -0,0 +1,234 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// pad as a bash loadable builtin, so scripts can pad without a fork() and
+// exec() per call:
+//
+//	enable -f ./pad.so pad
+//	pad -m left -l 10 -v padded "$value"
+//
+// It takes the same options as pad, plus -v VAR to assign the result to VAR
+// instead of printing it, like printf -v does. Build it with make pad.so,
+// which needs the headers of the bash-builtins package (or of examples/ in a
+// bash source tree).
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "loadables.h"
+
+// bash's config.h and glibc's limits.h claim names our headers use, too
+#undef PACKAGE
+#undef VERSION
+#undef PACKAGE_BUGREPORT
+#undef CHAR_WIDTH
+
+#include "padding.h"
+#include "options.h"
+
+// Everything one call of the builtin allocates, reset by the next one. Most
+// calls need no more than arena_buf.
+static struct arena arena;
+static char arena_buf[PAD_STACK];
+
+/**
+ * builtin_argv() - Turn the words of the builtin into an argv for parse()
+ *
+ * @list: The words
+ * @argc: Set to the number of arguments
+ * @var: Set to the argument of -v, or NULL if there is none
+ *
+ * -v is ours and does not go into the result, everything else is passed on
+ * as it is. -v is only picked up where an option can be, i.e. not as the
+ * value of another option or after --.
+ *
+ * Returns:
+ * * A NULL-terminated argv, from the arena. Its strings belong to @list.
+ * * NULL on allocation failure
+ */
+static char **builtin_argv(WORD_LIST *list, int *argc, char **var)
+{
+	WORD_LIST *l;
+	int n = 1;
+
+	for (l = list; l; l = l->next)
+		++n;
+
+	char **argv = arena_alloc(&arena, (n + 1) * sizeof(char *));
+
+	if (!argv)
+		return NULL;
+
+	*argc = 0;
+	*var = NULL;
+	argv[(*argc)++] = this_command_name;
+
+	for (l = list; l; l = l->next) {
+		char *w = l->word->word;
+
+		if (!strcmp(w, "--")) {
+			for (; l; l = l->next)
+				argv[(*argc)++] = l->word->word;
+			break;
+		}
+
+		if (!strcmp(w, "-v") && l->next) {
+			l = l->next;
+			*var = l->word->word;
+			continue;
+		}
+
+		argv[(*argc)++] = w;
+
+		if (option_takes_value(w) && l->next) {
+			l = l->next;
+			argv[(*argc)++] = l->word->word;
+		}
+	}
+
+	argv[*argc] = NULL;
+	return argv;
+}
+
+/**
+ * pad_out() - Pad a string and print it or assign it to a variable
+ *
+ * @o: The options
+ * @size: Size to pad to, see options_size()
+ * @var: Variable to assign the result to, or NULL to print it
+ *
+ * The result is built in the arena, which is what a script padding table
+ * cells in a loop asks for: once the arena is as large as the longest
+ * result, no call allocates anything.
+ *
+ * Returns: EXECUTION_SUCCESS or EXECUTION_FAILURE
+ */
+static int pad_out(struct options *o, size_t size, char *var)
+{
+	size_t len;
+	char *buf = pad_alloc(&arena, o->mode, strview_bytes(o->s, o->s_len),
+			      size, o->padding_char, &len);
+
+	if (!buf) {
+		builtin_error("%s", strerror(errno));
+		return EXECUTION_FAILURE;
+	}
+
+	if (var)
+		return bind_variable(var, buf, 0) ? EXECUTION_SUCCESS :
+						    EXECUTION_FAILURE;
+
+	fwrite(buf, 1, len, stdout);
+	putchar('\n');
+	return sh_chkwrite(EXECUTION_SUCCESS);
+}
+
+/**
+ * pad_builtin() - The pad builtin
+ *
+ * @list: The words after pad
+ *
+ * Like main() of pad, but without the seccomp filter, which would stay in
+ * place for the rest of the shell, and with -v.
+ *
+ * Returns: EXECUTION_SUCCESS, EXECUTION_FAILURE or EX_USAGE
+ */
+int pad_builtin(WORD_LIST *list)
+{
+	int argc, ws = 0;
+	int ret = EXECUTION_FAILURE;
+	char *var;
+	struct options *o;
+	char **argv;
+
+	if (!arena.buf)
+		arena_init_buf(&arena, arena_buf, sizeof(arena_buf));
+
+	arena_reset(&arena);
+
+	if (!(argv = builtin_argv(list, &argc, &var))) {
+		builtin_error("%s", strerror(errno));
+		return EXECUTION_FAILURE;
+	}
+
+	if (!(o = parse(&arena, argc, argv)))
+		return EXECUTION_FAILURE;
+
+	if (o->err) {
+		print_usage();
+		ret = (o->err - 1) ? EX_USAGE : EXECUTION_SUCCESS;
+		goto out;
+	}
+
+	if (var && !legal_identifier(var)) {
+		sh_invalidid(var);
+		ret = EX_USAGE;
+		goto out;
+	}
+
+	// The shell is the client already
+	if (o->serve) {
+		builtin_error("--serve cannot be used in the builtin");
+		ret = EX_USAGE;
+		goto out;
+	}
+
+	if (var && o->stream) {
+		builtin_error("-v cannot be used with --stream");
+		ret = EX_USAGE;
+		goto out;
+	}
+
+	if ((o->mode & MODE_MASK) == MODE_CENTRE &&
+	    (ws = get_winsize()) == -1)
+		goto out;
+
+	size_t size = options_size(o, ws);
+
+	if (o->stream) {
+		// pad_stream() writes to the file descriptor, past stdout
+		fflush(stdout);
+		int err = options_run_stream(o, size, -1);
+
+		ret = err ? EXECUTION_FAILURE : EXECUTION_SUCCESS;
+		goto out;
+	}
+
+	ret = pad_out(o, size, var);
+out:
+	options_free(o);
+	return ret;
+}
+
+/**
+ * pad_builtin_unload() - Free the arena once the builtin is disabled
+ *
+ * @name: Name of the builtin
+ *
+ * Called by bash on enable -d pad.
+ */
+void pad_builtin_unload(char *name)
+{
+	(void)name;
+	arena_free(&arena);
+}
+
+char *pad_doc[] = {
+	"Pad a string.",
+	"",
+	"Pad STRING to LENGTH characters with CHAR, the same way pad(1)",
+	"does and with the same options. With -v VAR the result is assigned",
+	"to the shell variable VAR instead of being printed.",
+	(char *)NULL
+};
+
+struct builtin pad_struct = {
+	"pad",
+	pad_builtin,
+	BUILTIN_ENABLED,
+	pad_doc,
+	"pad [-l LENGTH] [-c CHAR] [-m MODE] [-v VAR] STRING",
+	0
+};
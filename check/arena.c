@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Pads batches of records of mixed widths with pad_alloc(), resetting the
+// arena after each batch, the way the builtin and the stream modes use it.
+// Once a batch as large as any to come went through, the arena must not ask
+// malloc() for another block, which arena.allocs counts. Every result has to
+// be what pad_view() makes of the same record.
+//
+//	check-arena
+//
+// Prints ok, or what went wrong.
+
+#include <stdio.h>
+#include <string.h>
+#include "padding.h"
+#include "arena.h"
+
+#define BATCHES 20000
+// Largest number of records per batch
+#define BATCH 16
+// Largest width a record is padded to
+#define WIDTH 600
+
+#define CHAR "᪥"
+
+static const char *strings[] = { "", "x", "String※", "日本語",
+				 "a somewhat longer record than the others" };
+
+/**
+ * pad_batch() - Pad a batch of records and compare them to pad_view()
+ *
+ * @a: The arena, reset afterwards
+ * @n: Number of records
+ * @seed: Picks the records, their modes and their widths, moved on
+ * @widest: Pad empty records to WIDTH instead, the largest result there is
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int pad_batch(struct arena *a, int n, unsigned int *seed, int widest)
+{
+	static const int modes[] = { MODE_LEFT, MODE_RIGHT, MODE_BOTH };
+	static char want[WIDTH * CHAR_WIDTH + 64];
+
+	for (int i = 0; i < n; ++i) {
+		*seed = *seed * 1103515245 + 12345;
+
+		size_t pick = (*seed >> 8) %
+			      (sizeof(strings) / sizeof(*strings));
+		struct strview v = strview_str(strings[widest ? 0 : pick]);
+		int mode = modes[(*seed >> 4) % 3];
+		size_t size = widest ? WIDTH : 1 + (*seed >> 16) % WIDTH;
+		size_t len;
+		char *got = pad_alloc(a, mode, v, size, CHAR, &len);
+
+		if (!got) {
+			perror("check-arena");
+			return 1;
+		}
+
+		size_t want_len = pad_view(want, sizeof(want), mode, v, size,
+					   CHAR);
+
+		if (len != want_len || memcmp(got, want, len) || got[len]) {
+			printf("%s padded to %zu differs\n", v.data, size);
+			return 1;
+		}
+	}
+
+	arena_reset(a);
+	return 0;
+}
+
+/**
+ * check() - Pad all batches and watch the allocations of the arena
+ *
+ * @a: The arena, initialised
+ * @name: What @a starts out with, for the messages
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int check(struct arena *a, const char *name)
+{
+	unsigned int seed = 1;
+
+	if (pad_batch(a, BATCH, &seed, 1))
+		return 1;
+
+	unsigned long allocs = a->allocs;
+
+	for (int i = 0; i < BATCHES; ++i) {
+		seed = seed * 1103515245 + 12345;
+
+		if (pad_batch(a, 1 + (seed >> 16) % BATCH, &seed, 0))
+			return 1;
+
+		if (a->allocs != allocs) {
+			printf("%s: batch %d allocated, %lu blocks after %lu\n",
+			       name, i, a->allocs, allocs);
+			return 1;
+		}
+	}
+
+	arena_free(a);
+	return 0;
+}
+
+int main(void)
+{
+	static char buf[PAD_STACK];
+	struct arena heap;
+	struct arena stack;
+
+	arena_init(&heap);
+	arena_init_buf(&stack, buf, sizeof(buf));
+
+	if (check(&heap, "heap") || check(&stack, "stack"))
+		return 1;
+
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,199 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Pushes padded records through a strbuf from strbuf_open() into a pipe that
+// is read slower than it is written. The write end is non-blocking, so the
+// strbuf sees short writes and EAGAIN, and a timer interrupts it with EINTR
+// all along. What comes out of the pipe has to be byte for byte what the same
+// calls put into a strbuf from strbuf_alloc().
+//
+//	check-strbuf-fd
+//
+// Prints ok, or what went wrong.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "padding.h"
+#include "strbuf.h"
+
+#define RECORDS 20000
+// Small, so the strbuf is flushed often and some records are larger
+#define FLUSH 4096
+// Largest read of the slow reader
+#define READ 8192
+
+#define STRING "String※"
+#define CHAR "᪥"
+
+static void on_alarm(int sig)
+{
+	(void)sig;
+}
+
+/**
+ * produce() - Pad all records onto a strbuf
+ *
+ * @s: The strbuf
+ *
+ * Every kind of append there is: padded strings, padding larger than @s,
+ * which strbuf_fill() takes a buffer at a time, and bytes larger than @s,
+ * which strbuf_append_n() writes straight to the file descriptor.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int produce(struct strbuf *s)
+{
+	static const int modes[] = { MODE_LEFT, MODE_RIGHT, MODE_BOTH };
+	static char big[3 * FLUSH];
+
+	memset(big, 'x', sizeof(big));
+
+	for (int i = 0; i < RECORDS; ++i) {
+		size_t size = 10 + i % 300;
+
+		if (i % 1000 == 999)
+			size = 2 * FLUSH;
+
+		if (pad_mode(modes[i % 3], strview_str(STRING), size, s, CHAR) ||
+		    strbuf_append_n(s, "\n", 1))
+			return 1;
+
+		if (i % 2000 == 1999 &&
+		    (strbuf_fill(s, CHAR, sizeof(CHAR) - 1, 3 * FLUSH) ||
+		     strbuf_append_n(s, big, sizeof(big))))
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * writer() - Write all records to a non-blocking pipe
+ *
+ * @fd: Write end of the pipe
+ *
+ * Returns: Exit status of the writing process
+ */
+static int writer(int fd)
+{
+	struct sigaction sa = { .sa_handler = on_alarm };
+	struct itimerval it = { { 0, 500 }, { 0, 500 } };
+	struct strbuf s;
+
+	// No SA_RESTART, so write() and poll() fail with EINTR
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) || sigaction(SIGALRM, &sa, NULL) ||
+	    setitimer(ITIMER_REAL, &it, NULL) || strbuf_open(&s, fd, FLUSH)) {
+		perror("check-strbuf-fd");
+		return 1;
+	}
+
+	int ret = produce(&s) || strbuf_flush(&s);
+
+	if (ret)
+		perror("check-strbuf-fd - write");
+
+	strbuf_release(&s);
+	return ret;
+}
+
+/**
+ * reader() - Read the pipe slowly and compare it to what was expected
+ *
+ * @fd: Read end of the pipe
+ * @want: The bytes expected
+ *
+ * Reads of random size, with a pause after each, keep the pipe full most of
+ * the time.
+ *
+ * Returns:
+ * * 0 if the pipe carried @want
+ * * 1 if not
+ */
+static int reader(int fd, const struct strbuf *want)
+{
+	static char buf[READ];
+	struct timespec pause = { 0, 20000 };
+	unsigned int seed = 1;
+	size_t at = 0;
+
+	for (;;) {
+		seed = seed * 1103515245 + 12345;
+
+		ssize_t n = read(fd, buf, 1 + (seed >> 16) % READ);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			perror("check-strbuf-fd - read");
+			return 1;
+		}
+		if (!n)
+			break;
+
+		if (at + n > want->len || memcmp(buf, want->data + at, n)) {
+			printf("differs after %zu bytes\n", at);
+			return 1;
+		}
+
+		at += n;
+		nanosleep(&pause, NULL);
+	}
+
+	if (at != want->len) {
+		printf("%zu of %zu bytes arrived\n", at, want->len);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct strbuf want;
+	int fds[2];
+	int status;
+	pid_t pid;
+
+	if (strbuf_alloc(&want, 0) || produce(&want)) {
+		perror("check-strbuf-fd");
+		return 1;
+	}
+
+	if (pipe(fds) || (pid = fork()) < 0) {
+		perror("check-strbuf-fd");
+		return 1;
+	}
+
+	if (!pid) {
+		close(fds[0]);
+		_exit(writer(fds[1]));
+	}
+
+	close(fds[1]);
+
+	int ret = reader(fds[0], &want);
+
+	close(fds[0]);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		printf("writer failed\n");
+		ret = 1;
+	}
+
+	if (!ret)
+		printf("ok\n");
+
+	strbuf_release(&want);
+	return ret;
+}
@@ -11,20 +11,20 @@ cleanup_binary()
 compile_binary_debug()
 {
 	cleanup_binary
-	cc -g -O0 -lseccomp -D_PAD_DEBUG src/*.c -o binary
+	cc -g -O0 -pthread -lseccomp -D_PAD_DEBUG src/*.c -o binary
 }
 
 compile_binary_prodish()
 {
 	cleanup_binary
-	cc -g -O2 -lseccomp -D_PAD_DEBUG -pipe -march=native -fstack-protector-strong -fcf-protection \
+	cc -g -O2 -lseccomp -D_PAD_DEBUG -pipe -fstack-protector-strong -fcf-protection \
 		-fpie -fPIC -std=c99 -D_DEFAULT_SOURCE -fno-delete-null-pointer-checks \
 		-fno-strict-overflow -fno-strict-aliasing \
 		-ftrivial-auto-var-init=zero -fstrict-flex-arrays=3 \
 		-fstack-clash-protection \
 		-Wformat=2 -Wtrampolines \
 		-Wimplicit-fallthrough \
-		-pedantic -pedantic-errors -Wall -Wextra -lseccomp -Wl,-z,defs \
+		-pedantic -pedantic-errors -Wall -Wextra -pthread -lseccomp -Wl,-z,defs \
 		-Wl,-z,now -Wl,-z,relro -Wl,-z,nodlopen -Wl,-z,noexecstack \
 		src/*.c -o binary
 }
@@ -40,6 +40,17 @@ run_test()
 	printf '%b\n' "$?"
 }
 
+run_stream_test()
+{
+	FILE="$1"
+	shift
+
+	valgrind --quiet --error-exitcode="$VALGRIND_ERROR_EXIT" --leak-check=full \
+		--show-leak-kinds=all -s --track-origins=yes ./binary --stream "$@" < "$FILE" > /dev/null
+
+	printf '%b\n' "$?"
+}
+
 run_tests_debug()
 {
 	printf 'RUNNING DEBUG TESTS\n'
@@ -54,6 +65,16 @@ run_tests_debug()
 			failed_tests=$((failed_tests + 1))
 			printf 'TEST NO. %b (%b) FAILED!\n' "$i" "$testcase"
 		fi
+		if [ "$(run_stream_test "$testcase")" = "$VALGRIND_ERROR_EXIT" ]
+		then
+			failed_tests=$((failed_tests + 1))
+			printf 'STREAM TEST NO. %b (%b) FAILED!\n' "$i" "$testcase"
+		fi
+		if [ "$(run_stream_test "$testcase" -j 4)" = "$VALGRIND_ERROR_EXIT" ]
+		then
+			failed_tests=$((failed_tests + 1))
+			printf 'PIPELINE TEST NO. %b (%b) FAILED!\n' "$i" "$testcase"
+		fi
 		i=$((i + 1))
 	done
 }
@@ -73,6 +94,16 @@ run_tests_prodish()
 			failed_tests=$((failed_tests + 1))
 			printf 'TEST NO. %b (%b) FAILED!\n' "$i" "$testcase"
 		fi
+		if [ "$(run_stream_test "$testcase")" = "$VALGRIND_ERROR_EXIT" ]
+		then
+			failed_tests=$((failed_tests + 1))
+			printf 'STREAM TEST NO. %b (%b) FAILED!\n' "$i" "$testcase"
+		fi
+		if [ "$(run_stream_test "$testcase" -j 4)" = "$VALGRIND_ERROR_EXIT" ]
+		then
+			failed_tests=$((failed_tests + 1))
+			printf 'PIPELINE TEST NO. %b (%b) FAILED!\n' "$i" "$testcase"
+		fi
 		i=$((i + 1))
 	done
 }
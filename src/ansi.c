@@ -0,0 +1,151 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "simd.h"
+#include "ansi.h"
+
+/**
+ * ansi_string() - Length of a control string
+ *
+ * @s: The string, after its introducer
+ * @len: Length of @s in bytes
+ *
+ * OSC, DCS, SOS, PM and APC end with ST (ESC \). BEL ends them, too, as
+ * xterm and most others accept it after OSC.
+ *
+ * Returns:
+ * * Number of bytes up to and including the terminator
+ * * 0 if there is none in @s
+ */
+static size_t ansi_string(const char *s, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		if (s[i] == '\a')
+			return i + 1;
+
+		if (s[i] == ANSI_ESC && i + 1 < len && s[i + 1] == '\\')
+			return i + 2;
+	}
+
+	return 0;
+}
+
+/**
+ * ansi_escape() - Length of an escape sequence
+ *
+ * @s: The sequence, starting with ANSI_ESC
+ * @len: Length of @s in bytes
+ *
+ * Knows the forms of ECMA-48: CSI (ESC [) with parameter and intermediate
+ * bytes up to a final byte, the control strings, see ansi_string(), and ESC
+ * with intermediate bytes up to a final byte, e.g. ESC ( B. A CSI that
+ * contains anything else is malformed and ends before it, as it does on
+ * a terminal.
+ *
+ * Returns:
+ * * Number of bytes of the sequence
+ * * 0 if it does not end within @len bytes
+ */
+size_t ansi_escape(const char *s, size_t len)
+{
+	size_t i;
+
+	if (len < 2)
+		return 0;
+
+	switch (s[1]) {
+	case '[':
+		for (i = 2; i < len; ++i) {
+			unsigned char c = s[i];
+
+			if (c >= 0x40 && c <= 0x7e)
+				return i + 1;
+			if (c < 0x20 || c > 0x3f)
+				return i;
+		}
+
+		return 0;
+	case ']':
+	case 'P':
+	case 'X':
+	case '^':
+	case '_': {
+		size_t n = ansi_string(s + 2, len - 2);
+
+		return n ? n + 2 : 0;
+	}
+	}
+
+	for (i = 1; i < len; ++i) {
+		unsigned char c = s[i];
+
+		// A final byte, or anything else that cuts the sequence short
+		if (c < 0x20 || c > 0x2f)
+			return (c >= 0x30 && c <= 0x7e) ? i + 1 : i;
+	}
+
+	return 0;
+}
+
+/**
+ * ansi_complete() - Length of the complete escape sequences of some bytes
+ *
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ *
+ * Jumps from one ANSI_ESC to the next with simd_find_byte().
+ *
+ * Returns: @len, less an escape sequence cut off at the end of @s
+ */
+size_t ansi_complete(const char *s, size_t len)
+{
+	const char *p = s;
+	const char *end = s + len;
+
+	while ((p = simd_find_byte(p, end - p, ANSI_ESC))) {
+		size_t n = ansi_escape(p, end - p);
+
+		if (!n)
+			return p - s;
+
+		p += n;
+	}
+
+	return len;
+}
+
+/**
+ * ansi_tail() - Start of the escape sequences some bytes end with
+ *
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ *
+ * Used to keep the sequences, e.g. one resetting the color, that come after
+ * the point where a string is cut.
+ *
+ * Returns: Offset of the first of the escape sequences that make up the end
+ * of @s, @len if it does not end with any
+ */
+size_t ansi_tail(const char *s, size_t len)
+{
+	const char *p = s;
+	const char *end = s + len;
+	const char *tail = end;
+
+	while (p < end) {
+		const char *e = simd_find_byte(p, end - p, ANSI_ESC);
+
+		if (!e)
+			return len;
+
+		if (e != p || tail == end)
+			tail = e;
+
+		size_t n = ansi_escape(e, end - e);
+
+		p = n ? e + n : end;
+	}
+
+	return tail - s;
+}
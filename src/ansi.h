@@ -0,0 +1,17 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef ANSI_H
+#define ANSI_H
+#include <stddef.h>
+
+#define ANSI_ESC '\033'
+
+// string starting with ANSI_ESC, length of string in bytes
+size_t ansi_escape(const char *, size_t);
+// string, length of string in bytes
+size_t ansi_complete(const char *, size_t);
+size_t ansi_tail(const char *, size_t);
+
+#endif
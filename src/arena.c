@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "arena.h"
+
+/**
+ * arena_init() - Initialise an empty arena
+ *
+ * @a: The arena
+ *
+ * No memory is allocated until the first arena_alloc().
+ */
+void arena_init(struct arena *a)
+{
+	a->head = NULL;
+	a->buf = NULL;
+	a->used = 0;
+	a->total = 0;
+	a->allocs = 0;
+}
+
+/**
+ * arena_init_buf() - Initialise an arena that starts out in memory of its own
+ *
+ * @a: The arena
+ * @buf: The memory, e.g. on the stack, it has to outlive @a
+ * @size: Number of bytes in @buf
+ *
+ * Allocations are served from @buf as long as they fit, and only then from
+ * the heap, so a short-lived arena that stays small allocates nothing.
+ * @buf is taken up again after arena_free(). A @buf too small to be of use
+ * is ignored.
+ */
+void arena_init_buf(struct arena *a, void *buf, size_t size)
+{
+	uintptr_t p = (uintptr_t)buf;
+	size_t skip = (ARENA_ALIGN - p % ARENA_ALIGN) % ARENA_ALIGN;
+
+	arena_init(a);
+
+	if (size < skip + sizeof(struct arena_block) + ARENA_ALIGN)
+		return;
+
+	a->buf = (struct arena_block *)(p + skip);
+	a->buf->next = NULL;
+	a->buf->size = size - skip - sizeof(struct arena_block);
+	a->head = a->buf;
+	a->total = a->buf->size;
+}
+
+/**
+ * arena_grow() - Add a block to an arena
+ *
+ * @a: The arena
+ * @n: Number of bytes the block has to hold at least
+ *
+ * A new block is twice as large as all blocks so far, so an arena that is
+ * never reset needs a logarithmic number of them.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure, with errno set
+ */
+static int arena_grow(struct arena *a, size_t n)
+{
+	size_t size = a->total ? a->total * 2 : ARENA_BLOCK;
+
+	if (n > SIZE_MAX / 2 - sizeof(struct arena_block)) {
+		errno = ENOMEM;
+		return 1;
+	}
+
+	if (size < n)
+		size = n;
+
+	struct arena_block *b = malloc(sizeof(*b) + size);
+
+	if (!b)
+		return 1;
+
+	b->next = a->head;
+	b->size = size;
+	a->head = b;
+	a->used = 0;
+	a->total += size;
+	++a->allocs;
+	return 0;
+}
+
+/**
+ * arena_alloc() - Allocate memory from an arena
+ *
+ * @a: The arena
+ * @n: Number of bytes
+ *
+ * Moves past @n bytes of the current block, rounded up to ARENA_ALIGN, or
+ * starts a new block should they not fit. The memory is neither cleared nor
+ * freed on its own, it stays valid until arena_reset() or arena_free().
+ *
+ * Returns:
+ * * The memory
+ * * NULL on allocation failure, with errno set
+ */
+void *arena_alloc(struct arena *a, size_t n)
+{
+	if (n > SIZE_MAX - ARENA_ALIGN) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if ((!a->head || n > a->head->size - a->used) && arena_grow(a, n))
+		return NULL;
+
+	void *p = a->head->data + a->used;
+
+	a->used += n;
+	return p;
+}
+
+/**
+ * arena_zalloc() - Allocate cleared memory from an arena
+ *
+ * @a: The arena
+ * @n: Number of bytes
+ *
+ * Returns: See arena_alloc()
+ */
+void *arena_zalloc(struct arena *a, size_t n)
+{
+	void *p = arena_alloc(a, n);
+
+	if (p)
+		memset(p, 0, n);
+
+	return p;
+}
+
+/**
+ * arena_free() - Free all blocks of an arena
+ *
+ * @a: The arena
+ *
+ * Everything allocated from @a is gone, @a is empty again and can be used
+ * as it is, starting over with its own memory if it has any. @a->allocs is
+ * kept.
+ */
+void arena_free(struct arena *a)
+{
+	while (a->head) {
+		struct arena_block *next = a->head->next;
+
+		if (a->head != a->buf)
+			free(a->head);
+		a->head = next;
+	}
+
+	a->head = a->buf;
+	a->used = 0;
+	a->total = a->buf ? a->buf->size : 0;
+}
+
+/**
+ * arena_reset() - Take back everything allocated from an arena
+ *
+ * @a: The arena
+ *
+ * Meant to be called once per record or per batch of them. The memory is
+ * kept for the next one. Should it have taken more than one block, they are
+ * replaced by a single one as large as all of them together, so from then
+ * on a batch that needs no more than the largest one so far allocates
+ * nothing, which @a->allocs shows.
+ */
+void arena_reset(struct arena *a)
+{
+	if (a->head && a->head->next) {
+		size_t total = a->total;
+
+		arena_free(a);
+		if (a->buf && a->buf->size >= total)
+			return;
+
+		// Without it, the next arena_alloc() starts over small
+		a->head = NULL;
+		a->total = 0;
+		if (arena_grow(a, total))
+			arena_free(a);
+	}
+
+	a->used = 0;
+}
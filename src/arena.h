@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+// Size of the first block of an arena
+#define ARENA_BLOCK (4 << 10)
+// Every allocation starts at a multiple of this
+#define ARENA_ALIGN 16
+
+/**
+ * struct arena_block - A block of memory an arena hands out
+ *
+ * @next: The block allocated before this one, if any
+ * @size: Number of bytes in @data
+ * @data: The memory
+ */
+struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	char data[];
+};
+
+/**
+ * struct arena - Memory handed out front to back and taken back at once
+ *
+ * @head: The block allocations come from, NULL before the first one
+ * @buf: Block in memory of the caller, see arena_init_buf(), never freed
+ * @used: Number of bytes of @head handed out
+ * @total: Number of bytes in all blocks
+ * @allocs: Number of times the arena asked malloc() for a block
+ */
+struct arena {
+	struct arena_block *head;
+	struct arena_block *buf;
+	size_t used;
+	size_t total;
+	unsigned long allocs;
+};
+
+void arena_init(struct arena *);
+// arena, memory to start with, its size in bytes
+void arena_init_buf(struct arena *, void *, size_t);
+// arena, number of bytes
+void *arena_alloc(struct arena *, size_t);
+void *arena_zalloc(struct arena *, size_t);
+void arena_reset(struct arena *);
+void arena_free(struct arena *);
+
+#endif
@@ -0,0 +1,476 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "padding.h"
+#include "simd.h"
+#include "ansi.h"
+#include "stream.h"
+#include "fields.h"
+#include "autowidth.h"
+
+/**
+ * struct measure - Widest record or fields so far
+ *
+ * @fl: The fields to measure, NULL to measure whole records
+ * @mode: Padding mode, for how to measure, see pad_length()
+ * @delim: Record separator
+ * @field: Number of the field we are in - 1
+ * @count: Number of characters of it so far
+ * @open: Set if the last record has no separator yet
+ * @max: Widest field, by number - 1, or widest record
+ */
+struct measure {
+	const struct fields *fl;
+	int mode;
+	char delim;
+	size_t field;
+	size_t count;
+	int open;
+	size_t *max;
+};
+
+/**
+ * struct input - All of the input, in one piece
+ *
+ * @data: The input
+ * @len: Length of @data in bytes
+ * @buf: @data, if it was read into memory
+ * @map: The mapping @data points into, if any
+ * @map_len: Length of @map
+ */
+struct input {
+	const char *data;
+	size_t len;
+	char *buf;
+	void *map;
+	size_t map_len;
+};
+
+/**
+ * measure_field() - End the current field
+ *
+ * @m: The measurements
+ */
+static void measure_field(struct measure *m)
+{
+	size_t n = m->fl ? m->fl->n : 1;
+
+	if (m->field < n && m->count > m->max[m->field])
+		m->max[m->field] = m->count;
+
+	++m->field;
+	m->count = 0;
+}
+
+/**
+ * measure_part() - Measure a part of a record
+ *
+ * @m: The measurements
+ * @s: The part, without a record separator
+ * @len: Length of @s in bytes
+ *
+ * Lengths add up over any split of the bytes between characters, so a record
+ * or a field may be measured in as many parts as it was read in. Fields after
+ * the last one of @m->fl are not even looked at.
+ */
+static void measure_part(struct measure *m, const char *s, size_t len)
+{
+	const char *end = s + len;
+
+	if (!m->fl) {
+		m->count += pad_length(m->mode, s, len);
+		return;
+	}
+
+	while (m->field < m->fl->n) {
+		const char *d = simd_find_byte(s, end - s, m->fl->delim);
+
+		m->count += pad_length(m->mode, s, (d ? d : end) - s);
+		if (!d)
+			return;
+
+		measure_field(m);
+		s = d + 1;
+	}
+}
+
+/**
+ * measure() - Measure the next bytes of the input
+ *
+ * @m: The measurements
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ */
+static void measure(struct measure *m, const char *s, size_t len)
+{
+	const char *end = s + len;
+
+	while (s < end) {
+		const char *d = simd_find_byte(s, end - s, m->delim);
+
+		measure_part(m, s, (d ? d : end) - s);
+		if (!d) {
+			m->open = 1;
+			return;
+		}
+
+		measure_field(m);
+		m->field = 0;
+		m->open = 0;
+		s = d + 1;
+	}
+}
+
+/**
+ * spill_open() - Create a temporary file to spill the input to
+ *
+ * The file is created in $TMPDIR, or /tmp, and unlinked right away. This has
+ * to happen before the seccomp filter is in place.
+ *
+ * Returns:
+ * * The file descriptor
+ * * -1 on any error
+ */
+int spill_open(void)
+{
+	const char *dir = getenv("TMPDIR");
+
+	if (!dir || !*dir)
+		dir = "/tmp";
+
+	char *path = malloc(strlen(dir) + sizeof("/pad.XXXXXX"));
+
+	if (!path) {
+		perror("pad - auto-width");
+		return -1;
+	}
+
+	sprintf(path, "%s/pad.XXXXXX", dir);
+
+	int fd = mkstemp(path);
+
+	if (fd < 0)
+		perror("pad - auto-width");
+	else
+		unlink(path);
+
+	free(path);
+	return fd;
+}
+
+/**
+ * spill_write() - Append bytes to the spill file
+ *
+ * @fd: The spill file
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int spill_write(int fd, const char *s, size_t len)
+{
+	while (len) {
+		ssize_t n = write(fd, s, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("pad - auto-width");
+			return 1;
+		}
+
+		s += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * input_map() - Map a file descriptor as the input
+ *
+ * @in: The input
+ * @fd: The file descriptor
+ * @off: Offset of the input in it
+ * @len: Size of the file
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int input_map(struct input *in, int fd, size_t off, size_t len)
+{
+	if (off >= len)
+		return 0;
+
+	in->map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (in->map == MAP_FAILED) {
+		in->map = NULL;
+		perror("pad - auto-width");
+		return 1;
+	}
+
+	in->map_len = len;
+	// Read front to back, once per pass
+	madvise(in->map, len, MADV_SEQUENTIAL);
+	in->data = (const char *)in->map + off;
+	in->len = len - off;
+	return 0;
+}
+
+/**
+ * utf8_complete() - Length of the complete characters of some bytes
+ *
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ *
+ * Returns: @len, less the start of a character cut off at the end of @s
+ */
+static size_t utf8_complete(const char *s, size_t len)
+{
+	for (size_t i = len; i && len - i < 4; --i) {
+		unsigned char c = s[i - 1];
+
+		if ((c & 0xc0) == 0x80)
+			continue;
+
+		size_t n = (c >= 0xf0) ? 4 : (c >= 0xe0) ? 3 : (c >= 0xc0) ? 2 : 1;
+
+		return (i - 1 + n > len) ? i - 1 : len;
+	}
+
+	return len;
+}
+
+/**
+ * record_complete() - Length of the complete records of some bytes
+ *
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ * @delim: Record separator
+ *
+ * Returns: @len, less the record cut off at the end of @s
+ */
+static size_t record_complete(const char *s, size_t len, char delim)
+{
+	while (len && s[len - 1] != delim)
+		--len;
+
+	return len;
+}
+
+/**
+ * input_read() - Read and measure all of the input
+ *
+ * @in: The input
+ * @fd: The file descriptor to read from
+ * @spill: The spill file, created here if needed and -1
+ * @m: The measurements
+ *
+ * The input is read into a buffer that grows up to AUTOWIDTH_MEM bytes. Should
+ * there be more, every time the buffer is full it is appended to @spill
+ * instead, which is mapped once the input ends. Either way, every read is
+ * measured right away, so the input only has to be gone through once more.
+ * Only complete characters are measured, the start of one cut off by a read
+ * waits for the next one, as terminal columns do not add up over a split
+ * character. With MODE_ANSI, so does an escape sequence cut off, and with
+ * MODE_GRAPHEMES all of the record cut off, as clusters may be made up of any
+ * number of characters, unless either fills all of the buffer.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int input_read(struct input *in, int fd, int *spill, struct measure *m)
+{
+	size_t size = STREAM_BLOCK;
+	size_t used = 0;
+	size_t measured = 0;
+	size_t spilled = 0;
+	char *buf = malloc(size);
+
+	if (!buf)
+		goto err;
+
+	for (;;) {
+		if (used == size && size < AUTOWIDTH_MEM && !spilled) {
+			char *tmp = realloc(buf, size * 2);
+
+			if (!tmp)
+				goto err;
+
+			buf = tmp;
+			size *= 2;
+		} else if (used == size) {
+			if (*spill < 0 && (*spill = spill_open()) < 0)
+				goto out;
+
+			// A record or an escape sequence that does not end,
+			// measure what there is of it
+			if (!measured) {
+				measure(m, buf, used);
+				measured = used;
+			}
+
+			if (spill_write(*spill, buf, measured))
+				goto out;
+
+			spilled += measured;
+			used -= measured;
+			memmove(buf, buf + measured, used);
+			measured = 0;
+		}
+
+		ssize_t n = read(fd, buf + used, size - used);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			goto err;
+		}
+
+		if (!n)
+			break;
+
+		used += n;
+
+		size_t done = utf8_complete(buf + measured, used - measured);
+
+		if (m->mode & MODE_ANSI)
+			done = ansi_complete(buf + measured, done);
+		if (m->mode & MODE_GRAPHEMES)
+			done = record_complete(buf + measured, done, m->delim);
+
+		measure(m, buf + measured, done);
+		measured += done;
+	}
+
+	measure(m, buf + measured, used - measured);
+
+	if (!spilled) {
+		in->buf = buf;
+		in->data = buf;
+		in->len = used;
+		return 0;
+	}
+
+	if (spill_write(*spill, buf, used))
+		goto out;
+
+	free(buf);
+	return input_map(in, *spill, 0, spilled + used);
+err:
+	perror("pad - auto-width");
+out:
+	free(buf);
+	return 1;
+}
+
+/**
+ * pad_auto() - Pad every record or field to the widest one
+ *
+ * @fd: The file descriptor to read from
+ * @spill: Temporary file from spill_open(), or -1 to create one if needed
+ * @mode: Padding mode for whole records
+ * @padding_char: Padding character
+ * @delim: Record separator
+ * @fl: Fields to pad, NULL or without any to pad whole records
+ *
+ * The first pass finds the widest record, or the widest value of every field
+ * in @fl, with pad_length(). The second one pads every record to it like
+ * pad_stream() does, or every field to it, but at least to its width in @fl,
+ * like pad_fields() does. A regular file is mapped for both passes, anything
+ * else is read into memory by input_read(), or into @spill once there is too
+ * much of it, so memory use stays bounded for input of any size.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_auto(int fd, int spill, int mode, char *padding_char, char delim,
+	     const struct fields *fl)
+{
+	struct input in = { 0 };
+	struct measure m = { .mode = mode, .delim = delim };
+	struct fields wide = { 0 };
+	struct stat st;
+	int own = spill < 0;
+	int ret = 1;
+
+	if (fl && fl->n) {
+		m.fl = fl;
+		wide = *fl;
+		wide.f = malloc(fl->n * sizeof(struct field));
+	}
+
+	m.max = calloc(fl && fl->n ? fl->n : 1, sizeof(size_t));
+
+	if (!m.max || (m.fl && !wide.f)) {
+		perror("pad - auto-width");
+		goto out;
+	}
+
+	if (fstat(fd, &st)) {
+		perror("pad - auto-width");
+		goto out;
+	}
+
+	if (S_ISREG(st.st_mode)) {
+		off_t off = lseek(fd, 0, SEEK_CUR);
+
+		if (off < 0) {
+			perror("pad - auto-width");
+			goto out;
+		}
+
+		if (input_map(&in, fd, off, st.st_size))
+			goto out;
+
+		measure(&m, in.data, in.len);
+	} else if (input_read(&in, fd, &spill, &m)) {
+		goto out;
+	}
+
+	if (m.open)
+		measure_field(&m);
+
+	if (!in.len) {
+		ret = 0;
+		goto out;
+	}
+
+	if (!m.fl) {
+		ret = pad_region(in.data, in.len, mode, m.max[0], padding_char,
+				 delim);
+		goto out;
+	}
+
+	for (size_t i = 0; i < fl->n; ++i) {
+		wide.f[i] = fl->f[i];
+		if (m.max[i] > wide.f[i].width)
+			wide.f[i].width = m.max[i];
+	}
+
+	ret = pad_fields_region(in.data, in.len, &wide, padding_char, delim);
+out:
+	if (in.map)
+		munmap(in.map, in.map_len);
+	if (own && spill >= 0)
+		close(spill);
+	free(in.buf);
+	free(wide.f);
+	free(m.max);
+	return ret;
+}
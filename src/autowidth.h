@@ -0,0 +1,17 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef AUTOWIDTH_H
+#define AUTOWIDTH_H
+#include <stddef.h>
+#include "fields.h"
+
+// Input kept in memory, larger input is spilled to a temporary file
+#define AUTOWIDTH_MEM (64 << 20)
+
+int spill_open(void);
+// input fd, spill fd or -1, mode, padding, record separator, fields or NULL
+int pad_auto(int, int, int, char *, char, const struct fields *);
+
+#endif
@@ -0,0 +1,291 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "padding.h"
+#include "simd.h"
+#include "cache.h"
+
+#define CACHE_MUL 0x9e3779b97f4a7c15ULL
+
+/**
+ * cache_mix() - Mix eight bytes into a hash
+ *
+ * @h: The hash so far
+ * @v: The bytes
+ *
+ * Returns: The new hash
+ */
+static uint64_t cache_mix(uint64_t h, uint64_t v)
+{
+	h = (h ^ v) * CACHE_MUL;
+	return h ^ (h >> 32);
+}
+
+/**
+ * cache_hash() - Hash a record and how it is padded
+ *
+ * @mode: Padding mode
+ * @s: The record
+ * @len: Length of @s in bytes
+ * @size: Size of the padded record
+ * @f: The fill
+ * @delim: Separator
+ *
+ * The record is hashed eight bytes at a time, as most of them are short, and
+ * the result is mixed once more, so the low bits picking the slot depend on
+ * all of them.
+ *
+ * Returns: The hash
+ */
+static uint64_t cache_hash(int mode, const char *s, size_t len, size_t size,
+			   const struct pad_fill *f, char delim)
+{
+	uint64_t v = 0;
+
+	memcpy(&v, f->c, f->width);
+	uint64_t h = cache_mix(size, v ^ (uint64_t)(unsigned char)delim << 40 ^
+					     (uint64_t)mode << 48);
+
+	h = cache_mix(h, len);
+
+	for (; len >= 8; s += 8, len -= 8) {
+		memcpy(&v, s, 8);
+		h = cache_mix(h, v);
+	}
+
+	v = 0;
+	memcpy(&v, s, len);
+	h = cache_mix(h, v);
+
+	// Finaliser of MurmurHash3
+	h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+	h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 33);
+}
+
+/**
+ * cache_match() - Whether a slot holds a record, padded the same way
+ *
+ * Returns: 1 if it does, 0 if not
+ */
+static int cache_match(const struct cache_slot *slot, uint64_t hash, int mode,
+		       const char *s, size_t len, size_t size,
+		       const struct pad_fill *f, char delim)
+{
+	return slot->hash == hash && slot->key_len == len &&
+	       slot->size == size && slot->mode == mode &&
+	       slot->delim == delim && !strcmp(slot->c, f->c) &&
+	       !memcmp(slot->data + slot->off, s, len);
+}
+
+/**
+ * cache_victim() - Pick a slot to evict
+ *
+ * @c: The cache
+ * @home: Slot the hash of the new record picks
+ *
+ * This is CLOCK over the CACHE_PROBE slots of @home: a slot that was hit
+ * since we last came by gets a second chance and loses its reference bit,
+ * the first one that was not is evicted. Slots handed out in the current
+ * epoch are skipped, since the emitter may still point into them.
+ *
+ * Returns:
+ * * The slot
+ * * NULL if all of them are in use
+ */
+static struct cache_slot *cache_victim(struct pad_cache *c, size_t home)
+{
+	for (int pass = 0; pass < 2; ++pass) {
+		for (size_t i = 0; i < CACHE_PROBE; ++i) {
+			struct cache_slot *slot =
+				&c->slots[(home + i) & c->mask];
+
+			if (slot->epoch == c->epoch)
+				continue;
+
+			if (!slot->ref)
+				return slot;
+
+			slot->ref = 0;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * cache_init() - Initialise a cache
+ *
+ * @c: The cache
+ * @records: Number of records to keep, rounded up to a power of two
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure, with errno set
+ */
+int cache_init(struct pad_cache *c, size_t records)
+{
+	size_t n = CACHE_PROBE;
+
+	while (n < records)
+		n *= 2;
+
+	memset(c, 0, sizeof(struct pad_cache));
+	c->slots = calloc(n, sizeof(struct cache_slot));
+
+	if (!c->slots)
+		return 1;
+
+	c->mask = n - 1;
+	// Empty slots have epoch 0 and must not look handed out
+	c->epoch = 1;
+	return 0;
+}
+
+/**
+ * cache_free() - Free a cache
+ *
+ * @c: The cache
+ */
+void cache_free(struct pad_cache *c)
+{
+	if (!c->slots)
+		return;
+
+	for (size_t i = 0; i <= c->mask; ++i)
+		free(c->slots[i].data);
+
+	free(c->slots);
+	c->slots = NULL;
+}
+
+/**
+ * cache_pad() - Look up a padded record, or pad and add it
+ *
+ * @c: The cache
+ * @mode: Padding mode
+ * @s: The record
+ * @len: Length of @s in bytes
+ * @size: Size of the padded record (left offset for MODE_CENTRE)
+ * @f: The fill to pad with
+ * @delim: Separator appended to the padded record
+ * @out_len: Set to the length of the result
+ *
+ * The table is open addressed: a record lives in one of the CACHE_PROBE slots
+ * following the one its hash picks, and since slots are only ever reused and
+ * never emptied, the first empty one ends the search. A miss pads the record
+ * the way emit_pad() does into a new slot, evicting one if needed. The result
+ * stays valid until cache_release() was called, so it can be handed to
+ * emit() as is.
+ *
+ * Returns:
+ * * The padded record, followed by @delim
+ * * NULL if it was not added, as it is too large, was cut, all of its slots
+ *   are in use or memory ran out. The caller has to pad it itself then.
+ */
+const char *cache_pad(struct pad_cache *c, int mode, const char *s, size_t len,
+		      size_t size, const struct pad_fill *f, char delim,
+		      size_t *out_len)
+{
+	uint64_t hash = cache_hash(mode, s, len, size, f, delim);
+	size_t home = hash & c->mask;
+	struct cache_slot *slot = NULL;
+
+	for (size_t i = 0; i < CACHE_PROBE; ++i) {
+		struct cache_slot *tmp = &c->slots[(home + i) & c->mask];
+
+		if (!tmp->data) {
+			slot = tmp;
+			break;
+		}
+
+		if (cache_match(tmp, hash, mode, s, len, size, f, delim)) {
+			++c->hits;
+			tmp->ref = 1;
+			tmp->epoch = c->epoch;
+			*out_len = tmp->len;
+			return tmp->data;
+		}
+	}
+
+	++c->misses;
+
+	if (len > CACHE_ENTRY_MAX)
+		return NULL;
+
+	struct pad_layout l;
+
+	pad_layout(mode, s, len, size, &l);
+
+	// A slot has to hold all of the record to compare it
+	if (l.len < len || l.left > CACHE_ENTRY_MAX ||
+	    l.right > CACHE_ENTRY_MAX)
+		return NULL;
+
+	size_t total = pad_layout_size(&l, f->width) + 1;
+
+	if (total > CACHE_ENTRY_MAX)
+		return NULL;
+
+	if (!slot && !(slot = cache_victim(c, home)))
+		return NULL;
+
+	char *data = malloc(total);
+
+	if (!data)
+		return NULL;
+
+	if (slot->data) {
+		++c->evictions;
+		free(slot->data);
+	}
+
+	pad_layout_copy(data, &l, s, f);
+	data[total - 1] = delim;
+
+	*slot = (struct cache_slot){
+		.hash = hash,
+		.data = data,
+		.size = size,
+		.len = total,
+		.off = l.left * f->width,
+		.key_len = len,
+		.epoch = c->epoch,
+		.mode = mode,
+		.delim = delim,
+	};
+	memcpy(slot->c, f->c, CHAR_WIDTH);
+
+	*out_len = total;
+	return data;
+}
+
+/**
+ * cache_release() - Allow evicting what was handed out so far
+ *
+ * @c: The cache
+ *
+ * Called once nothing points into the records cache_pad() returned any more,
+ * e.g. after emit_flush().
+ */
+void cache_release(struct pad_cache *c)
+{
+	// Skip 0 on wrap around, that is the epoch of empty slots
+	if (!++c->epoch)
+		c->epoch = 1;
+}
+
+/**
+ * cache_report() - Print the counters of a cache to stderr
+ *
+ * @c: The cache
+ */
+void cache_report(const struct pad_cache *c)
+{
+	fprintf(stderr, "pad - cache: %lu hits, %lu misses, %lu evictions\n",
+		c->hits, c->misses, c->evictions);
+}
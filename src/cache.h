@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef CACHE_H
+#define CACHE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "padding.h"
+
+// Number of slots a record may end up in, starting at the one its hash picks
+#define CACHE_PROBE 8
+
+// Largest padded record, separator included, we keep
+#define CACHE_ENTRY_MAX 4096
+
+/**
+ * struct cache_slot - A padded record
+ *
+ * @hash: Hash of the record and how it was padded
+ * @data: The padded record, followed by its separator
+ * @size: Size it was padded to
+ * @len: Number of bytes in @data
+ * @off: Offset of the record in @data
+ * @key_len: Length of the record in bytes
+ * @epoch: Epoch of the cache @data was last handed out in
+ * @mode: Mode it was padded with
+ * @delim: Its separator
+ * @ref: Set on every hit, cleared when looking for a slot to evict
+ * @c: The padding character
+ */
+struct cache_slot {
+	uint64_t hash;
+	char *data;
+	size_t size;
+	uint32_t len;
+	uint32_t off;
+	uint32_t key_len;
+	unsigned int epoch;
+	unsigned char mode;
+	char delim;
+	unsigned char ref;
+	char c[CHAR_WIDTH];
+};
+
+/**
+ * struct pad_cache - Padded records, by record, mode, size, character and
+ * separator
+ *
+ * @slots: The table, a power of two of slots
+ * @mask: Number of slots - 1
+ * @epoch: Slots handed out in this epoch are not evicted
+ * @hits: Number of records found in the cache
+ * @misses: Number of records not found
+ * @evictions: Number of records dropped to make room for others
+ */
+struct pad_cache {
+	struct cache_slot *slots;
+	size_t mask;
+	unsigned int epoch;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+
+// cache, number of records to keep
+int cache_init(struct pad_cache *, size_t);
+void cache_free(struct pad_cache *);
+// cache, mode, input, length of input in bytes, size of result, fill,
+// separator, length of result
+const char *cache_pad(struct pad_cache *, int, const char *, size_t, size_t,
+		      const struct pad_fill *, char, size_t *);
+void cache_release(struct pad_cache *);
+void cache_report(const struct pad_cache *);
+
+#endif
@@ -0,0 +1,185 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "strbuf.h"
+#include "emit.h"
+
+/**
+ * emit_init() - Initialise an emitter
+ *
+ * @e: The emitter
+ * @fd: File descriptor to write to
+ */
+void emit_init(struct emitter *e, int fd)
+{
+	e->fd = fd;
+	e->n = 0;
+}
+
+/**
+ * emit() - Add a segment to the output
+ *
+ * @e: The emitter
+ * @s: The bytes to write
+ * @len: Number of bytes in @s
+ *
+ * @s is not copied, so it has to stay around until the next emit_flush().
+ * A segment that starts right where the previous one ends (e.g. a record and
+ * its separator in the input buffer) just extends the previous one. Should
+ * @e be out of segments, it is flushed first.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int emit(struct emitter *e, const char *s, size_t len)
+{
+	if (!len)
+		return 0;
+
+	if (e->n) {
+		struct iovec *last = &e->iov[e->n - 1];
+
+		if ((const char *)last->iov_base + last->iov_len == s) {
+			last->iov_len += len;
+			return 0;
+		}
+	}
+
+	if (e->n == EMIT_IOV && emit_flush(e))
+		return 1;
+
+	e->iov[e->n].iov_base = (void *)s;
+	e->iov[e->n].iov_len = len;
+	++e->n;
+
+	return 0;
+}
+
+/**
+ * emit_fill() - Add a padding run to the output
+ *
+ * @e: The emitter
+ * @f: The fill to pad with
+ * @count: Number of padding characters
+ *
+ * The run is made up of segments pointing into @f->block, so no padding
+ * string has to be built.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int emit_fill(struct emitter *e, const struct pad_fill *f, size_t count)
+{
+	while (count) {
+		size_t n = (count < f->chars) ? count : f->chars;
+
+		if (emit(e, f->block, n * f->width))
+			return 1;
+
+		count -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * emit_pad() - Add a padded string to the output
+ *
+ * @e: The emitter
+ * @mode: Padding mode
+ * @s: The string that shall be padded
+ * @len: Length of @s in bytes
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @f: The fill to pad with
+ *
+ * Produces the same output as pad_mode(), but as segments: the left padding,
+ * @s in place, and the right padding. If @s was cut, see pad_layout(), what
+ * is kept of it is in place, too, ELLIPSIS points to a literal.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int emit_pad(struct emitter *e, int mode, const char *s, size_t len,
+	     size_t size, const struct pad_fill *f)
+{
+	struct pad_layout l;
+
+	pad_layout(mode, s, len, size, &l);
+	return emit_layout(e, s, &l, f);
+}
+
+/**
+ * emit_layout() - Add a string that was already laid out to the output
+ *
+ * @e: The emitter
+ * @s: The string
+ * @l: Its layout, see pad_layout()
+ * @f: The fill to pad with
+ *
+ * Like emit_pad(), for callers that needed the layout before, e.g. to learn
+ * how large the result is, so @s is not measured again.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int emit_layout(struct emitter *e, const char *s, const struct pad_layout *l,
+		const struct pad_fill *f)
+{
+	return emit_fill(e, f, l->left) || emit(e, s, l->len) ||
+	       (l->ellipsis && emit(e, ELLIPSIS, ELLIPSIS_LEN)) ||
+	       emit(e, s + l->tail, l->tail_len) || emit_fill(e, f, l->right);
+}
+
+/**
+ * emit_flush() - Write out all collected segments
+ *
+ * @e: The emitter
+ *
+ * writev() may write less than we asked for, so we skip over whatever was
+ * written and try again with the rest, and like strbuf_flush() after errors
+ * strbuf_retry() says are worth it, e.g. EAGAIN on a non-blocking stdout.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int emit_flush(struct emitter *e)
+{
+	struct iovec *iov = e->iov;
+	int n = e->n;
+
+	e->n = 0;
+
+	while (n) {
+		ssize_t written = writev(e->fd, iov, n);
+
+		if (written < 0) {
+			if (strbuf_retry(e->fd))
+				continue;
+
+			perror("pad - emit");
+			return 1;
+		}
+
+		while (n && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			++iov;
+			--n;
+		}
+
+		if (n) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return 0;
+}
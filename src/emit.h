@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EMIT_H
+#define EMIT_H
+#include <stddef.h>
+#include <sys/uio.h>
+#include "padding.h"
+
+// Number of segments collected before they are written with writev()
+#define EMIT_IOV 1024
+
+/**
+ * struct emitter - Output described as a list of segments
+ *
+ * @fd: File descriptor the segments are written to
+ * @n: Number of segments in @iov
+ * @iov: The segments, pointing into memory owned by somebody else
+ */
+struct emitter {
+	int fd;
+	int n;
+	struct iovec iov[EMIT_IOV];
+};
+
+void emit_init(struct emitter *, int);
+int emit(struct emitter *, const char *, size_t);
+int emit_fill(struct emitter *, const struct pad_fill *, size_t);
+// emitter, mode, input, length of input in bytes, size of result, fill
+int emit_pad(struct emitter *, int, const char *, size_t, size_t,
+	     const struct pad_fill *);
+// emitter, input, its layout, fill
+int emit_layout(struct emitter *, const char *, const struct pad_layout *,
+		const struct pad_fill *);
+int emit_flush(struct emitter *);
+
+#endif
@@ -0,0 +1,272 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include "padding.h"
+#include "emit.h"
+#include "simd.h"
+#include "stream.h"
+#include "fields.h"
+
+/**
+ * struct fields_pad - What fields_record() needs
+ *
+ * @fl: The fields
+ * @fill: The fill to pad with
+ */
+struct fields_pad {
+	const struct fields *fl;
+	struct pad_fill fill;
+};
+
+/**
+ * fields_mode() - Parse the mode of a field
+ *
+ * @s: The mode, not NUL-terminated
+ * @len: Length of @s
+ *
+ * Unlike -m, the mode has to be spelled out. Centring a field on the
+ * terminal makes no sense.
+ *
+ * Returns:
+ * * MODE_LEFT, MODE_RIGHT or MODE_BOTH
+ * * -1 for anything else
+ */
+static int fields_mode(const char *s, size_t len)
+{
+	if (len == 4 && !strncasecmp(s, "left", 4))
+		return MODE_LEFT;
+	if (len == 5 && !strncasecmp(s, "right", 5))
+		return MODE_RIGHT;
+	if (len == 4 && !strncasecmp(s, "both", 4))
+		return MODE_BOTH;
+
+	return -1;
+}
+
+/**
+ * fields_parse() - Parse a spec of --fields
+ *
+ * @fl: Where to put the fields, its @delim is left alone
+ * @spec: Comma-separated list of FIELD:MODE:WIDTH, FIELD counting from 1
+ *
+ * A field given more than once is padded as given last.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 if @spec is invalid or on allocation failure
+ */
+int fields_parse(struct fields *fl, const char *spec)
+{
+	const char *p = spec;
+
+	fl->f = NULL;
+	fl->n = 0;
+
+	for (;;) {
+		char *end;
+
+		if (!isdigit((unsigned char)*p))
+			goto err;
+
+		errno = 0;
+		unsigned long n = strtoul(p, &end, 10);
+
+		if (errno || !n || n > FIELDS_MAX || *end != ':')
+			goto err;
+
+		p = end + 1;
+
+		size_t mlen = strcspn(p, ":");
+		int mode = fields_mode(p, mlen);
+
+		p += mlen;
+		if (mode < 0 || *p != ':' || !isdigit((unsigned char)p[1]))
+			goto err;
+
+		errno = 0;
+		unsigned long long width = strtoull(p + 1, &end, 10);
+
+		if (errno)
+			goto err;
+
+		if (n > fl->n) {
+			struct field *tmp = realloc(fl->f, n * sizeof(*tmp));
+
+			if (!tmp)
+				goto err;
+
+			memset(tmp + fl->n, 0, (n - fl->n) * sizeof(*tmp));
+			fl->f = tmp;
+			fl->n = n;
+		}
+
+		fl->f[n - 1] = (struct field){ 1, mode, width };
+
+		p = end;
+		if (!*p)
+			return 0;
+
+		if (*p++ != ',')
+			goto err;
+	}
+err:
+	fields_free(fl);
+	return 1;
+}
+
+/**
+ * fields_free() - Free parsed fields
+ *
+ * @fl: The fields
+ */
+void fields_free(struct fields *fl)
+{
+	free(fl->f);
+	fl->f = NULL;
+	fl->n = 0;
+}
+
+/**
+ * fields_record() - Add a record with its fields padded to the output
+ *
+ * @arg: The struct fields_pad
+ * @e: The emitter
+ * @s: The record, NULL once the segments were written
+ * @len: Length of @s in bytes
+ * @sep: The separator of the record
+ *
+ * The fields are found with simd_find_byte(), like the records are. A padded
+ * field is laid out by emit_pad(), everything else is added in place, where
+ * emit() merges it with the field separators around it. So are all fields
+ * after the last one to pad, in one go.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int fields_record(void *arg, struct emitter *e, const char *s,
+			 size_t len, const char *sep)
+{
+	struct fields_pad *fp = arg;
+	const struct fields *fl = fp->fl;
+
+	if (!s)
+		return 0;
+
+	const char *end = s + len;
+
+	for (size_t i = 0; i < fl->n; ++i) {
+		const char *d = simd_find_byte(s, end - s, fl->delim);
+		size_t flen = (d ? d : end) - s;
+		const struct field *f = &fl->f[i];
+
+		int err = f->pad ? emit_pad(e, f->mode, s, flen, f->width,
+					    &fp->fill) :
+				   emit(e, s, flen);
+
+		if (err)
+			return 1;
+
+		if (!d)
+			return emit(e, sep, 1);
+
+		if (emit(e, d, 1))
+			return 1;
+
+		s = d + 1;
+	}
+
+	return emit(e, s, end - s) || emit(e, sep, 1);
+}
+
+/**
+ * fields_fill() - Create the fill for the widest field
+ *
+ * @fp: Its fields are set already
+ * @padding_char: Padding character
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure
+ */
+static int fields_fill(struct fields_pad *fp, char *padding_char)
+{
+	size_t max = 0;
+
+	for (size_t i = 0; i < fp->fl->n; ++i)
+		if (fp->fl->f[i].width > max)
+			max = fp->fl->f[i].width;
+
+	if (fill_init(&fp->fill, padding_char, max)) {
+		perror("pad - fields");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * pad_fields() - Pad fields of every record read from a file descriptor
+ *
+ * @fd: The file descriptor to read from
+ * @fl: The fields to pad and the field separator
+ * @padding_char: Padding character
+ * @delim: Record separator
+ *
+ * Every record is split into fields on @fl->delim, and every field is padded
+ * the way pad_mode() would, within one pass over the input. Records with
+ * fewer fields than @fl has are padded as far as they go.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_fields(int fd, const struct fields *fl, char *padding_char,
+	       char delim)
+{
+	struct fields_pad fp = { .fl = fl };
+
+	if (fields_fill(&fp, padding_char))
+		return 1;
+
+	int ret = stream_records(fd, delim, fields_record, &fp);
+
+	fill_free(&fp.fill);
+	return ret;
+}
+
+/**
+ * pad_fields_region() - Pad fields of every record of a memory region
+ *
+ * @s: The region
+ * @len: Length of @s in bytes
+ * @fl: The fields to pad and the field separator
+ * @padding_char: Padding character
+ * @delim: Record separator
+ *
+ * Produces the same output as pad_fields() does for the same input.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_fields_region(const char *s, size_t len, const struct fields *fl,
+		      char *padding_char, char delim)
+{
+	struct fields_pad fp = { .fl = fl };
+
+	if (fields_fill(&fp, padding_char))
+		return 1;
+
+	int ret = stream_region(s, len, delim, fields_record, &fp);
+
+	fill_free(&fp.fill);
+	return ret;
+}
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef FIELDS_H
+#define FIELDS_H
+#include <stddef.h>
+
+// Highest field number --fields takes
+#define FIELDS_MAX 1024
+
+// Field separator, if not given with -d
+#define FIELDS_DELIM '\t'
+
+/**
+ * struct field - How to pad one field
+ *
+ * @pad: Set if the field is padded at all
+ * @mode: MODE_LEFT, MODE_RIGHT or MODE_BOTH
+ * @width: Size of the padded field
+ */
+struct field {
+	int pad;
+	int mode;
+	size_t width;
+};
+
+/**
+ * struct fields - How to pad the fields of every record
+ *
+ * @f: The fields, by number - 1
+ * @n: Number of fields in @f, fields after the last one are left alone
+ * @delim: Field separator
+ */
+struct fields {
+	struct field *f;
+	size_t n;
+	char delim;
+};
+
+// fields, spec like 1:left:12,3:right:8
+int fields_parse(struct fields *, const char *);
+void fields_free(struct fields *);
+// input fd, fields, padding, record separator
+int pad_fields(int, const struct fields *, char *, char);
+// input, length of input in bytes, fields, padding, record separator
+int pad_fields_region(const char *, size_t, const struct fields *, char *,
+		      char);
+
+#endif
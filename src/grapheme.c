@@ -0,0 +1,218 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdint.h>
+#include "grapheme-table.h"
+#include "width.h"
+#include "grapheme.h"
+
+#define VS16 0xfe0f
+
+/**
+ * struct grapheme_state - Where the segmentation is at
+ *
+ * @columns: Measure clusters in terminal columns instead of counting them
+ * @max: Length the clusters may take
+ * @open: Set once there is a current cluster
+ * @prev: Property of the last character
+ * @pict: 1 after Extended_Pictographic Extend*, 2 once a ZWJ followed
+ * @ri: Set after a regional indicator that starts a flag
+ * @len: Length of the finished clusters
+ * @cur: Length of the current cluster
+ * @start: Offset of the current cluster in bytes
+ */
+struct grapheme_state {
+	int columns;
+	size_t max;
+	int open;
+	int prev;
+	int pict;
+	int ri;
+	size_t len;
+	size_t cur;
+	size_t start;
+};
+
+/**
+ * grapheme_prop() - Grapheme_Cluster_Break of a code point
+ *
+ * @cp: The code point
+ *
+ * Looked up in the two-level table of grapheme-table.h, see
+ * tools/gen-grapheme.pl. Stray continuation bytes stick to the cluster before
+ * them, like simd_utf8_count() does not count them, anything else that is not
+ * a character is a cluster of its own.
+ *
+ * Returns: A value of enum grapheme_prop
+ */
+static int grapheme_prop(unsigned int cp)
+{
+	if (cp == UTF8_STRAY)
+		return GB_EXTEND;
+
+	if (cp >= sizeof(grapheme_stage1) << GRAPHEME_BLOCK_SHIFT)
+		return GB_OTHER;
+
+	const uint8_t *block =
+		grapheme_stage2[grapheme_stage1[cp >> GRAPHEME_BLOCK_SHIFT]];
+	unsigned int i = cp & ((1 << GRAPHEME_BLOCK_SHIFT) - 1);
+
+	return (block[i >> 1] >> ((i & 1) * 4)) & 0xf;
+}
+
+/**
+ * grapheme_break() - Whether there is a boundary before a character
+ *
+ * @st: The state after the character before it
+ * @prop: Property of the character
+ *
+ * The rules GB3 to GB13 of UAX #29, extended grapheme clusters. GB1 and GB2
+ * are up to the caller.
+ *
+ * Returns: 1 if there is one, 0 if not
+ */
+static int grapheme_break(const struct grapheme_state *st, int prop)
+{
+	int prev = st->prev;
+
+	if (prev == GB_CR && prop == GB_LF)
+		return 0;
+	if (prev == GB_CR || prev == GB_LF || prev == GB_CONTROL ||
+	    prop == GB_CR || prop == GB_LF || prop == GB_CONTROL)
+		return 1;
+
+	// Hangul syllables
+	if (prev == GB_L && (prop == GB_L || prop == GB_V || prop == GB_LV ||
+			     prop == GB_LVT))
+		return 0;
+	if ((prev == GB_LV || prev == GB_V) && (prop == GB_V || prop == GB_T))
+		return 0;
+	if ((prev == GB_LVT || prev == GB_T) && prop == GB_T)
+		return 0;
+
+	if (prop == GB_EXTEND || prop == GB_ZWJ || prop == GB_SPACINGMARK ||
+	    prev == GB_PREPEND)
+		return 0;
+
+	// Emoji ZWJ sequences and flags
+	if (st->pict == 2 && prop == GB_EXTPICT)
+		return 0;
+	if (prev == GB_RI && prop == GB_RI && st->ri)
+		return 0;
+
+	return 1;
+}
+
+/**
+ * grapheme_next() - Add a character to the segmentation
+ *
+ * @st: The state, updated
+ * @cp: The character
+ * @at: Its offset in bytes
+ *
+ * In columns, a cluster takes as many as its widest character, but a flag or
+ * an emoji asked to be shown as one with U+FE0F takes two.
+ *
+ * Returns: 1 if the current cluster ends here, but does not fit, 0 if not
+ */
+static int grapheme_next(struct grapheme_state *st, unsigned int cp,
+			 size_t at)
+{
+	int prop = grapheme_prop(cp);
+	size_t cols = (cp == UTF8_STRAY) ? 0 : codepoint_width(cp);
+	int flag = prop == GB_RI && st->prev == GB_RI && st->ri;
+
+	if (!st->open || grapheme_break(st, prop)) {
+		if (st->len + st->cur > st->max)
+			return 1;
+
+		st->len += st->cur;
+		st->cur = st->columns ? cols : 1;
+		st->start = at;
+		st->open = 1;
+	} else if (st->columns) {
+		if (flag || (cp == VS16 && st->pict == 1))
+			st->cur = 2;
+		else if (cols > st->cur)
+			st->cur = cols;
+	}
+
+	// Regional indicators pair up from the first one of a run on
+	st->ri = prop == GB_RI && !flag;
+
+	if (prop == GB_EXTPICT || (st->pict == 1 && prop == GB_EXTEND))
+		st->pict = 1;
+	else if (st->pict == 1 && prop == GB_ZWJ)
+		st->pict = 2;
+	else
+		st->pict = 0;
+
+	st->prev = prop;
+	return 0;
+}
+
+/**
+ * grapheme_prefix() - Longest start of a UTF-8 string within some clusters
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ * @columns: Measure clusters in terminal columns instead of counting them
+ * @max: Length the start may take
+ * @n: Set to the length it takes
+ *
+ * Goes through @s once, front to back. Whether a cluster fits is only known
+ * once it ends, so the cut goes where the first one that does not fit
+ * starts. Printable ASCII never joins the character before it, unless that
+ * is a prepended mark, and every one of them is a cluster of its own, so
+ * runs of it are skipped with ascii_span() instead of going through the
+ * state machine.
+ *
+ * Returns: Length of the start in bytes, @len if all of @s fits
+ */
+size_t grapheme_prefix(const char *s, size_t len, int columns, size_t max,
+		       size_t *n)
+{
+	struct grapheme_state st = { .columns = columns, .max = max };
+	const char *p = s;
+	const char *end = s + len;
+
+	while (p < end) {
+		size_t used = st.len + st.cur;
+		size_t room = (used < max) ? max - used : 0;
+		size_t span = 0;
+
+		if ((size_t)(end - p) < room)
+			room = end - p;
+
+		if (st.prev != GB_PREPEND)
+			span = ascii_span(p, room);
+
+		if (span) {
+			st.len = used + span - 1;
+			st.cur = 1;
+			st.start = p + span - 1 - s;
+			st.open = 1;
+			st.prev = GB_OTHER;
+			st.pict = 0;
+			st.ri = 0;
+			p += span;
+			continue;
+		}
+
+		size_t at = p - s;
+
+		if (grapheme_next(&st, utf8_decode(&p, end), at)) {
+			*n = st.len;
+			return st.start;
+		}
+	}
+
+	if (st.len + st.cur > max) {
+		*n = st.len;
+		return st.start;
+	}
+
+	*n = st.len + st.cur;
+	return len;
+}
@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef GRAPHEME_H
+#define GRAPHEME_H
+#include <stddef.h>
+
+// string, length of string in bytes, measure in columns, length, set to the
+// length taken
+size_t grapheme_prefix(const char *, size_t, int, size_t, size_t *);
+
+#endif
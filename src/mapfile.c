@@ -0,0 +1,454 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "padding.h"
+#include "simd.h"
+#include "stream.h"
+#include "pipeline.h"
+#include "mapfile.h"
+
+/**
+ * struct mapped - A mapped input file and how to pad it
+ *
+ * @map: The contents of the file
+ * @len: Size of the file
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @fill: The padding character, shared by all threads
+ * @delim: Record separator
+ */
+struct mapped {
+	const char *map;
+	size_t len;
+	int mode;
+	size_t size;
+	struct pad_fill fill;
+	char delim;
+};
+
+/**
+ * struct part - The share of the input one thread pads
+ *
+ * @m: The input
+ * @start: Offset of the first record of the part in @m->map
+ * @end: Offset right behind the last record of the part
+ * @bytes: Size of the padded part, after the first pass
+ * @off: Offset of the padded part in the output
+ * @write: 0 to measure the part, 1 to write it
+ * @err: Set if writing failed
+ */
+struct part {
+	struct mapped *m;
+	size_t start;
+	size_t end;
+	size_t bytes;
+	off_t off;
+	int write;
+	int err;
+};
+
+/**
+ * struct out - Buffered output of one thread
+ *
+ * @buf: MAPFILE_BUF bytes of padded records
+ * @len: Number of bytes in @buf
+ * @off: Offset of @buf in the output
+ */
+struct out {
+	char *buf;
+	size_t len;
+	off_t off;
+};
+
+/**
+ * out_write() - Write bytes to stdout at an offset
+ *
+ * @off: The offset, moved past the bytes
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int out_write(off_t *off, const char *s, size_t len)
+{
+	while (len) {
+		ssize_t n = pwrite(STDOUT_FILENO, s, len, *off);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("pad - file");
+			return 1;
+		}
+
+		s += n;
+		len -= n;
+		*off += n;
+	}
+
+	return 0;
+}
+
+/**
+ * out_put() - Add bytes to the output
+ *
+ * @o: The output
+ * @s: The bytes
+ * @len: Number of bytes in @s
+ *
+ * Whatever does not fit into @o->buf any more flushes it first. Should @s be
+ * larger than the whole buffer, it is written straight away.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int out_put(struct out *o, const char *s, size_t len)
+{
+	if (o->len + len > MAPFILE_BUF) {
+		if (out_write(&o->off, o->buf, o->len))
+			return 1;
+
+		o->len = 0;
+
+		if (len > MAPFILE_BUF)
+			return out_write(&o->off, s, len);
+	}
+
+	memcpy(o->buf + o->len, s, len);
+	o->len += len;
+	return 0;
+}
+
+/**
+ * out_fill() - Add a padding run to the output
+ *
+ * @o: The output
+ * @f: The fill to pad with
+ * @count: Number of padding characters
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int out_fill(struct out *o, const struct pad_fill *f, size_t count)
+{
+	while (count) {
+		size_t n = (count < f->chars) ? count : f->chars;
+
+		if (out_put(o, f->block, n * f->width))
+			return 1;
+
+		count -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * part_pad() - Measure or write a part
+ *
+ * @p: The part
+ *
+ * Both passes lay the records out the same way emit_pad() does and give a
+ * last record without a separator one. The first pass only adds up the size
+ * of the result in @p->bytes, the second one writes it to @p->off.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int part_pad(struct part *p)
+{
+	struct mapped *m = p->m;
+	const struct pad_fill *f = &m->fill;
+	const char *s = m->map + p->start;
+	const char *end = m->map + p->end;
+	struct out o = { .off = p->off };
+
+	if (p->write && !(o.buf = malloc(MAPFILE_BUF))) {
+		perror("pad - file");
+		return 1;
+	}
+
+	p->bytes = 0;
+
+	while (s < end) {
+		const char *d = simd_find_byte(s, end - s, m->delim);
+		size_t len = (d ? d : end) - s;
+		struct pad_layout l;
+
+		pad_layout(m->mode, s, len, m->size, &l);
+
+		if (!p->write)
+			p->bytes += pad_layout_size(&l, f->width) + 1;
+		else if (out_fill(&o, f, l.left) || out_put(&o, s, l.len) ||
+			 (l.ellipsis && out_put(&o, ELLIPSIS, ELLIPSIS_LEN)) ||
+			 out_put(&o, s + l.tail, l.tail_len) ||
+			 out_fill(&o, f, l.right) || out_put(&o, &m->delim, 1))
+			goto err;
+
+		if (!d)
+			break;
+
+		s = d + 1;
+	}
+
+	if (p->write && out_write(&o.off, o.buf, o.len))
+		goto err;
+
+	free(o.buf);
+	return 0;
+err:
+	free(o.buf);
+	return 1;
+}
+
+/**
+ * part_thread() - Thread function running part_pad()
+ *
+ * @arg: The part
+ *
+ * Returns: NULL
+ */
+static void *part_thread(void *arg)
+{
+	struct part *p = arg;
+
+	p->err = part_pad(p);
+	return NULL;
+}
+
+/**
+ * parts_run() - Run a pass over all parts at once
+ *
+ * @parts: The parts
+ * @n: Number of parts
+ * @write: 0 to measure, 1 to write
+ *
+ * Every part but the first gets a thread of its own, the first one is done
+ * by the calling thread. Should a thread not be created, its part is done by
+ * the calling thread, too.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 if any part failed
+ */
+static int parts_run(struct part *parts, int n, int write)
+{
+	pthread_t *threads = calloc(n, sizeof(pthread_t));
+	int *started = calloc(n, sizeof(int));
+	int ret = 0;
+
+	for (int i = 0; i < n; ++i)
+		parts[i].write = write;
+
+	for (int i = 1; i < n; ++i)
+		started[i] = threads && started &&
+			     !pthread_create(&threads[i], NULL, part_thread,
+					     &parts[i]);
+
+	part_thread(&parts[0]);
+
+	for (int i = 1; i < n; ++i) {
+		if (started && started[i])
+			pthread_join(threads[i], NULL);
+		else
+			part_thread(&parts[i]);
+	}
+
+	for (int i = 0; i < n; ++i)
+		ret |= parts[i].err;
+
+	free(started);
+	free(threads);
+	return ret;
+}
+
+/**
+ * parts_split() - Split the input into parts
+ *
+ * @m: The input
+ * @parts: The parts
+ * @n: Number of parts
+ *
+ * Every part gets about the same number of bytes, moved forward to the next
+ * record boundary. Parts may end up empty if records are long.
+ */
+static void parts_split(struct mapped *m, struct part *parts, int n)
+{
+	size_t start = 0;
+
+	for (int i = 0; i < n; ++i) {
+		size_t end = m->len;
+
+		if (i < n - 1) {
+			end = m->len / n * (i + 1);
+			if (end < start)
+				end = start;
+
+			const char *d = simd_find_byte(m->map + end,
+						       m->len - end, m->delim);
+
+			end = d ? (size_t)(d - m->map) + 1 : m->len;
+		}
+
+		parts[i] = (struct part){ .m = m, .start = start, .end = end };
+		start = end;
+	}
+}
+
+/**
+ * pad_mapped() - Pad a mapped file in two passes
+ *
+ * @m: The input
+ * @jobs: Number of threads
+ *
+ * The first pass measures every part, so a prefix sum over their sizes gives
+ * each one its offset in the output. The output is grown to its final size up
+ * front, unless it is larger already, and the second pass has every thread
+ * pwrite() its part to its own offset, in whatever order they get there. We
+ * start at the current offset of stdout and leave it behind the output, so we
+ * can be written after, too.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int pad_mapped(struct mapped *m, int jobs)
+{
+	struct part *parts = calloc(jobs, sizeof(struct part));
+	struct stat st;
+	int ret = 1;
+
+	if (!parts) {
+		perror("pad - file");
+		return 1;
+	}
+
+	parts_split(m, parts, jobs);
+
+	if (parts_run(parts, jobs, 0))
+		goto out;
+
+	off_t off = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+
+	if (off < 0) {
+		perror("pad - file");
+		goto out;
+	}
+
+	for (int i = 0; i < jobs; ++i) {
+		parts[i].off = off;
+		off += parts[i].bytes;
+	}
+
+	// Only ever grown, like write() would, so an output opened with
+	// 1<>file keeps whatever it has behind ours
+	if (fstat(STDOUT_FILENO, &st) ||
+	    (st.st_size < off && ftruncate(STDOUT_FILENO, off)) ||
+	    lseek(STDOUT_FILENO, off, SEEK_SET) < 0) {
+		perror("pad - file");
+		goto out;
+	}
+
+	ret = parts_run(parts, jobs, 1);
+out:
+	free(parts);
+	return ret;
+}
+
+/**
+ * pad_file() - Pad every record of a file
+ *
+ * @path: The file
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @padding_char: Padding character
+ * @delim: Record separator
+ * @jobs: Number of threads
+ *
+ * Produces the same output as pad_stream(). If both @path and stdout are
+ * plain files, @path is mapped and padded by @jobs threads with
+ * pad_mapped(), which needs neither an input buffer nor an ordered writer.
+ * Otherwise (e.g. stdout is a pipe or opened for appending, which pwrite()
+ * does not work with) @path is read like stdin is with --stream or -j.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_file(const char *path, int mode, size_t size, char *padding_char,
+	     char delim, int jobs)
+{
+	struct stat in, out;
+	struct mapped m = {
+		.mode = mode,
+		.size = size,
+		.delim = delim,
+	};
+	int ret = 1;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		perror("pad - file");
+		return 1;
+	}
+
+	if (fstat(fd, &in) || fstat(STDOUT_FILENO, &out)) {
+		perror("pad - file");
+		goto out;
+	}
+
+	int flags = fcntl(STDOUT_FILENO, F_GETFL);
+
+	if (!S_ISREG(in.st_mode) || !S_ISREG(out.st_mode) || flags < 0 ||
+	    (flags & O_APPEND)) {
+		ret = (jobs > 1) ? pad_pipeline(fd, mode, size, padding_char,
+						delim, jobs) :
+				   pad_stream(fd, mode, size, padding_char,
+					      delim, NULL);
+		goto out;
+	}
+
+	m.len = in.st_size;
+	if (!m.len) {
+		ret = 0;
+		goto out;
+	}
+
+	void *map = mmap(NULL, m.len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (map == MAP_FAILED) {
+		perror("pad - file");
+		goto out;
+	}
+
+	// Every part is read front to back once per pass
+	madvise(map, m.len, MADV_SEQUENTIAL);
+	m.map = map;
+
+	if (fill_init(&m.fill, padding_char, size))
+		perror("pad - file");
+	else
+		ret = pad_mapped(&m, jobs);
+
+	fill_free(&m.fill);
+	munmap(map, m.len);
+out:
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,15 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+#include <stddef.h>
+
+// Size of the output buffer of every thread
+#define MAPFILE_BUF (1 << 20)
+
+// path, mode, size of result, padding, record separator, threads
+int pad_file(const char *, int, size_t, char *, char, int);
+
+#endif
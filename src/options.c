@@ -0,0 +1,650 @@
+// SPDX-FileCopyrightText: 2023 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include "padding.h"
+#include "strbuf.h"
+#include "stream.h"
+#include "pipeline.h"
+#include "mapfile.h"
+#include "fields.h"
+#include "autowidth.h"
+#include "options.h"
+
+#define CHECK_OPT(x, y, z) !strcmp(x, y) || !strcmp(x, z)
+
+/**
+ * print_usage() - Print usage information to stderr
+ *
+ * Prints usage information (options, modes, version and author) to stderr.
+ */
+void print_usage(void)
+{
+	fprintf(stderr,
+		"%s [-l LENGTH] [-c CHAR] [-m MODE] [-w] [-a] [--graphemes] "
+		"[--truncate] [--ellipsis] STRING\n"
+		"%s [-l LENGTH] [-c CHAR] [-m MODE] [-z] [-j JOBS] --stream\n"
+		"%s [-l LENGTH] [-c CHAR] [-m MODE] [-z] --cache RECORDS "
+		"[--cache-stats]\n"
+		"%s [-l LENGTH] [-c CHAR] [-m MODE] [-z] [-j JOBS] -f FILE\n"
+		"%s [-c CHAR] [-z] [-d DELIM] [--auto-width] --fields "
+		"FIELD:MODE:WIDTH,...\n"
+		"%s [-c CHAR] [-m MODE] [-z] --auto-width\n"
+		"%s --serve [--socket PATH]\n"
+		"Modes are: left, right, centre or both\n"
+		"-w measures in terminal columns instead of characters\n"
+		"-a skips ANSI escape sequences when measuring\n"
+		"--graphemes counts grapheme clusters instead of characters\n"
+		"--truncate cuts longer strings, --ellipsis ends them with an ellipsis\n"
+		"%s v%s - Send Bug reports to %s\n",
+		PACKAGE, PACKAGE, PACKAGE, PACKAGE, PACKAGE, PACKAGE, PACKAGE,
+		PACKAGE, VERSION,
+		PACKAGE_BUGREPORT);
+}
+
+/**
+ * get_winsize() - Return the column number of /dev/tty
+ *
+ * Report the number of columns avaiable in /dev/tty by first opening it
+ * read-only to get a file descriptor, then passing it to ioctl() with the
+ * TIOCGWINSZ request to get information about the dimensions of /dev/tty.
+ *
+ * Returns:
+ * * Number of columns
+ * * -1 on any error
+ */
+int get_winsize(void)
+{
+	struct winsize ws;
+	int fd;
+
+	if ((fd = open("/dev/tty", O_RDONLY)) < 0) {
+		perror(PACKAGE);
+		return -1;
+	}
+
+	if (ioctl(fd, TIOCGWINSZ, &ws) < 0) {
+		perror(PACKAGE);
+		close(fd);
+		return -1;
+	}
+
+	int tmp = ws.ws_col;
+	close(fd);
+	return tmp;
+}
+
+/**
+ * ceildiv() - Divide two integers, ceiled if needed
+ *
+ * @dividend: The dividend
+ * @divisor: The divisor
+ *
+ * Do a simple division, but if the interger result is
+ * smaller than the double result, ceil it.
+ *
+ * Return: ⌈@dividend / @divisor⌉
+ */
+int ceildiv(int dividend, int divisor)
+{
+	double result = (double)dividend / (double)divisor;
+	int ret = (int)(dividend / divisor);
+
+	return ((double)ret < result) ? ++ret : ret;
+}
+
+/**
+ * parse() - Parse commandline options
+ *
+ * @a: The arena to allocate the options from
+ * @argc: Number of arguments
+ * @argv: Argument array
+ *
+ * Check every element of @argv, but the first, to see if it is one of our
+ * defined arguments and set the coressponding values for the struct otpions.
+ * Parsing ends early if given the help flag.
+ *
+ * Returns:
+ * * a struct options with all necessary data
+ * * NULL on allocation failure
+ */
+struct options *parse(struct arena *a, int argc, char **argv)
+{
+	char *err = "";
+	struct options *o = arena_zalloc(a, sizeof(struct options));
+
+	if (!o) {
+		perror(PACKAGE);
+
+		return NULL;
+	}
+
+	o->merged_argv = NULL; // Ensure that o->merged_argv defaults to NULL
+	o->delim = '\n';
+	o->jobs = 1;
+	o->fields.delim = FIELDS_DELIM;
+
+	int flag_length = 0;
+	int flag_char = 0;
+	int flag_mode = 0;
+	int flag_string = 0;
+	int flag_merge = 0;
+	int flag_columns = 0;
+	int flag_ansi = 0;
+	int flag_graphemes = 0;
+	int flag_truncate = 0;
+	int flag_delim = 0;
+	int flag_standalone = 0;
+
+	int i;
+	for (i = 1; i < argc; ++i) {
+		if (CHECK_OPT(argv[i], "-l", "--length")) {
+			if (argc > (i + 1)) {
+				flag_length = 1;
+				char *tmp;
+				errno = 0;
+				o->length = strtoull(argv[i + 1], &tmp, 0);
+				if (argv[i + 1] == tmp || errno == ERANGE) {
+					err = "Invalid length passed to -l!";
+					goto abort;
+				}
+				++i;
+			} else {
+				err = "-l was set, but no length was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "-c", "--char")) {
+			if (argc > (i + 1)) {
+				if (strlen(argv[i + 1]) == 0)
+					goto char_err;
+
+				flag_char = 1;
+				o->padding_char = argv[i + 1];
+				++i;
+			} else {
+char_err:
+				err = "-c was set, but no char was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "-h", "--help")) {
+			goto help;
+		} else if (CHECK_OPT(argv[i], "-m", "--mode")) {
+			if (argc > (i + 1)) {
+				o->mode = hash(argv[i + 1]);
+				flag_mode = 1;
+				++i;
+			} else {
+				err = "-m was set, but no mode was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "-s", "--string")) {
+			if (argc > (i + 1)) {
+				flag_string = 1;
+				o->s = argv[i + 1];
+				o->s_len = strlen(o->s);
+				++i;
+			} else {
+				err = "-s was set, but no string was given";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "-w", "--columns")) {
+			flag_columns = 1;
+		} else if (CHECK_OPT(argv[i], "-a", "--ansi")) {
+			flag_ansi = 1;
+		} else if (CHECK_OPT(argv[i], "--graphemes", "--graphemes")) {
+			flag_graphemes = 1;
+		} else if (CHECK_OPT(argv[i], "--truncate", "--truncate")) {
+			flag_truncate |= MODE_TRUNCATE;
+		} else if (CHECK_OPT(argv[i], "--ellipsis", "--ellipsis")) {
+			flag_truncate |= MODE_TRUNCATE | MODE_ELLIPSIS;
+		} else if (CHECK_OPT(argv[i], "--stream", "--stream")) {
+			o->stream = 1;
+		} else if (CHECK_OPT(argv[i], "-z", "--zero-terminated")) {
+			// NUL-separated records only make sense on stdin
+			o->stream = 1;
+			o->delim = '\0';
+		} else if (CHECK_OPT(argv[i], "-j", "--jobs")) {
+			if (argc > (i + 1)) {
+				char *tmp;
+				errno = 0;
+				long jobs = strtol(argv[i + 1], &tmp, 0);
+				if (argv[i + 1] == tmp || errno == ERANGE ||
+				    jobs < 0 || jobs > MAX_JOBS) {
+					err = "Invalid number of jobs passed to -j!";
+					goto abort;
+				}
+
+				// 0 is one per CPU
+				if (!jobs)
+					jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+				o->jobs = (jobs > 0) ? jobs : 1;
+				// Like -z, jobs only make sense on stdin
+				o->stream = 1;
+				++i;
+			} else {
+				err = "-j was set, but no number of jobs was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "-f", "--file")) {
+			if (argc > (i + 1)) {
+				o->file = argv[i + 1];
+				// Records of a file instead of stdin
+				o->stream = 1;
+				++i;
+			} else {
+				err = "-f was set, but no file was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "--cache", "--cache")) {
+			if (argc > (i + 1)) {
+				char *tmp;
+				errno = 0;
+				o->cache = strtoull(argv[i + 1], &tmp, 0);
+				if (argv[i + 1] == tmp || errno == ERANGE ||
+				    !o->cache || o->cache > MAX_CACHE) {
+					err = "Invalid number of records passed to --cache!";
+					goto abort;
+				}
+
+				// Only records of stdin repeat
+				o->stream = 1;
+				++i;
+			} else {
+				err = "--cache was set, but no number of records was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "--cache-stats", "--cache-stats")) {
+			o->cache_stats = 1;
+		} else if (CHECK_OPT(argv[i], "--fields", "--fields")) {
+			if (argc > (i + 1)) {
+				fields_free(&o->fields);
+				if (fields_parse(&o->fields, argv[i + 1])) {
+					err = "Invalid fields passed to --fields!";
+					goto abort;
+				}
+
+				// Fields of the records of stdin
+				o->stream = 1;
+				++i;
+			} else {
+				err = "--fields was set, but no fields were given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "--auto-width", "--auto-width")) {
+			// Only all of stdin has a widest record
+			o->auto_width = 1;
+			o->stream = 1;
+		} else if (CHECK_OPT(argv[i], "-d", "--delimiter")) {
+			if (argc > (i + 1) && strlen(argv[i + 1]) == 1) {
+				o->fields.delim = argv[i + 1][0];
+				flag_delim = 1;
+				++i;
+			} else {
+				err = "-d was set, but no single byte delimiter was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "--serve", "--serve")) {
+			o->serve = 1;
+		} else if (CHECK_OPT(argv[i], "--socket", "--socket")) {
+			if (argc > (i + 1)) {
+				o->socket = argv[i + 1];
+				o->serve = 1;
+				++i;
+			} else {
+				err = "--socket was set, but no path was given.";
+				goto abort;
+			}
+		} else if (CHECK_OPT(argv[i], "--", "--")) {
+			flag_merge = 1;
+			++i;
+			goto skip;
+		} else if (argv[i][0] == '-') {
+			err = "Unknown argument";
+			goto abort;
+		} else {
+			flag_standalone = 1;
+		}
+	}
+
+skip:
+	if (flag_length && o->length < 1) {
+		err = "Length should be a non-zero positive integer.";
+		goto abort;
+	}
+
+	// Every request carries its own mode, length and padding character
+	if (o->serve &&
+	    (o->stream || flag_length || flag_char || flag_mode ||
+	     flag_columns || flag_ansi || flag_graphemes || flag_truncate ||
+	     flag_string || flag_merge || flag_standalone)) {
+		err = "--serve cannot be used with any option but --socket.";
+		goto abort;
+	}
+
+	// Records come from stdin or -f, there is no string to pad
+	if (o->stream && (flag_string || flag_merge || flag_standalone)) {
+		err = "A string cannot be given with --stream, -z, -j, -f, "
+		      "--cache, --fields or --auto-width.";
+		goto abort;
+	}
+
+	if (o->cache_stats && !o->cache) {
+		err = "--cache-stats cannot be used without --cache.";
+		goto abort;
+	}
+
+	if (o->cache && (o->jobs > 1 || o->file)) {
+		err = "--cache cannot be used with -j or -f.";
+		goto abort;
+	}
+
+	if (flag_delim && !o->fields.n) {
+		err = "-d cannot be used without --fields.";
+		goto abort;
+	}
+
+	if (o->fields.n && (o->jobs > 1 || o->file || o->cache)) {
+		err = "--fields cannot be used with -j, -f or --cache.";
+		goto abort;
+	}
+
+	if (o->auto_width &&
+	    (o->jobs > 1 || o->file || o->cache ||
+	     (o->mode & MODE_MASK) == MODE_CENTRE)) {
+		err = "--auto-width cannot be used with -j, -f, --cache or -m centre.";
+		goto abort;
+	}
+
+	if (flag_truncate && (o->mode & MODE_MASK) == MODE_CENTRE) {
+		err = "--truncate cannot be used with -m centre.";
+		goto abort;
+	}
+
+	if (!flag_length)
+		o->length = DEFAULT_LENGTH;
+
+	if (!flag_char)
+		o->padding_char = DEFAULT_CHAR;
+
+	if (!flag_mode)
+		o->mode = DEFAULT_MODE;
+
+	// How to measure and cut goes for every field, too
+	int flags = (flag_columns ? MODE_COLUMNS : 0) |
+		    (flag_ansi ? MODE_ANSI : 0) |
+		    (flag_graphemes ? MODE_GRAPHEMES : 0) | flag_truncate;
+
+	o->mode |= flags;
+	for (size_t f = 0; f < o->fields.n; ++f)
+		o->fields.f[f].mode |= flags;
+
+	if (flag_merge) {
+		o->merged_argv = merge_argv(a, argc, argv, i, &o->s_len);
+		if (!o->merged_argv) {
+			err = "Tried to merge argv, but failed!";
+			goto abort;
+		}
+
+		o->s = o->merged_argv;
+	} else if (!flag_string && !o->stream && !o->serve) {
+		o->s = last_standalone(argc, argv);
+		o->s_len = strlen(o->s);
+		if (!o->s_len) {
+			err = "No string was passed. If you want to pad an "
+			      "empty string, please use --string";
+			goto abort;
+		}
+	}
+
+	return o;
+abort:
+	fprintf(stderr, "%s\n", err);
+	o->err = 1;
+help:
+	o->err += 1;
+	return o;
+}
+
+/**
+ * options_free() - Free parsed options
+ *
+ * @o: What parse() returned, may be NULL
+ *
+ * Only frees what does not come from the arena of @o, which its owner
+ * resets or frees.
+ */
+void options_free(struct options *o)
+{
+	if (!o)
+		return;
+
+	fields_free(&o->fields);
+}
+
+/**
+ * options_size() - Size to pad to
+ *
+ * @o: The options
+ * @ws: Number of columns of the terminal, only used for MODE_CENTRE
+ *
+ * For every mode but MODE_CENTRE this is just @o->length. For MODE_CENTRE it
+ * is the number of padding characters that put a string of @o->length
+ * characters into the middle of the terminal.
+ *
+ * Returns: The size to hand to the padding functions
+ */
+size_t options_size(struct options *o, int ws)
+{
+	if ((o->mode & MODE_MASK) != MODE_CENTRE)
+		return o->length;
+
+	// Get the middle by slicing the size in half
+	int half = ceildiv(ws, 2);
+	int left = half - ceildiv(o->length, 2);
+
+	return (left > 0) ? left : 0;
+}
+
+/**
+ * options_run_stream() - Pad stdin, or a file, the way the options ask for
+ *
+ * @o: The options, with @o->stream set
+ * @size: Size to pad to, see options_size()
+ * @spill: File --auto-width may spill large input to, or -1
+ *
+ * Picks one of pad_auto(), pad_fields(), pad_file(), pad_pipeline(),
+ * pad_stream_cached() and pad_stream(), for pad and its builtin alike.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int options_run_stream(struct options *o, size_t size, int spill)
+{
+	if (o->auto_width)
+		return pad_auto(STDIN_FILENO, spill, o->mode, o->padding_char,
+				o->delim, o->fields.n ? &o->fields : NULL);
+
+	if (o->fields.n)
+		return pad_fields(STDIN_FILENO, &o->fields, o->padding_char,
+				  o->delim);
+
+	if (o->file)
+		return pad_file(o->file, o->mode, size, o->padding_char,
+				o->delim, o->jobs);
+
+	if (o->jobs > 1)
+		return pad_pipeline(STDIN_FILENO, o->mode, size,
+				    o->padding_char, o->delim, o->jobs);
+
+	if (o->cache)
+		return pad_stream_cached(STDIN_FILENO, o->mode, size,
+					 o->padding_char, o->delim, o->cache,
+					 o->cache_stats);
+
+	return pad_stream(STDIN_FILENO, o->mode, size, o->padding_char,
+			  o->delim, NULL);
+}
+
+/**
+ * option_takes_value() - Check if an option takes a value
+ *
+ * @w: A word of the command line
+ *
+ * Returns:
+ * * 1, if the word after @w is the value of @w
+ * * 0, if not
+ */
+int option_takes_value(const char *w)
+{
+	static const char *opts[] = { "-l", "--length", "-c", "--char", "-m",
+				      "--mode", "-s", "--string", "-j",
+				      "--jobs", "-f", "--file", "--socket",
+				      "--cache", "--fields", "-d",
+				      "--delimiter" };
+
+	for (size_t i = 0; i < sizeof(opts) / sizeof(opts[0]); ++i)
+		if (!strcmp(w, opts[i]))
+			return 1;
+
+	return 0;
+}
+
+/**
+ * last_standalone() - Return the last standalone argument
+ *
+ * @argc: Number of arguments
+ * @argv: Argument array
+ *
+ * For every element of @argv, after the first one, check if its free
+ * standing, i.e. it is not the value of an option, see option_takes_value().
+ * If it is free
+ * standing, keep track of it until we hit the next one and replace it.
+ *
+ * Since this uses an empty char * to keep track of standalones empty strings
+ * have to be padded with the explicit option.
+ *
+ * Returns: Either the last standalone string or an empty string
+ */
+char *last_standalone(int argc, char **argv)
+{
+	char *s = "";
+
+	for (int i = 1; i < argc; ++i) {
+		if (option_takes_value(argv[i]))
+			++i;
+		else
+			s = argv[i];
+	}
+
+	return s;
+}
+
+/**
+ * merge_argv() - Merge arguments
+ *
+ * @a: The arena to allocate the string from
+ * @argc: Number of arguments
+ * @argv: Argument array
+ * @i: First argument
+ * @len: Set to the length of the merged string in bytes
+ *
+ * Merges all arguments from @i until @argc into one string. Every argument is
+ * measured once, by slen_args(), and then copied with strbuf_add().
+ *
+ * Returns:
+ * * A string
+ * * NULL on any error
+ */
+char *merge_argv(struct arena *a, int argc, char **argv, int i, size_t *len)
+{
+	if (i >= argc)
+		return NULL;
+
+	struct strview *args = arena_alloc(a, (argc - i) * sizeof(*args));
+
+	if (!args) {
+		perror(PACKAGE);
+		return NULL;
+	}
+
+	size_t bytes = slen_args(argc, argv, i, args);
+
+	if (!bytes)
+		return NULL;
+
+	struct strbuf buf;
+
+	// Every argument is followed by a space, plus the final NUL byte
+	if (strbuf_arena(&buf, a, bytes + (argc - i) + 1)) {
+		perror(PACKAGE);
+		return NULL;
+	}
+
+	for (int j = 0; j < argc - i; ++j) {
+		strbuf_add(&buf, args[j]);
+		strbuf_putc(&buf, ' ');
+	}
+
+	*len = buf.len;
+	return strbuf_str(&buf);
+}
+
+/**
+ * slen_args() - Length of all strings from i upwards
+ *
+ * @argc: Number of arguments
+ * @argv: Argument array
+ * @i: From where to sum
+ * @args: Set to a view of every one of them, @argc - @i of them
+ *
+ * Sums all strlen()'s of @argv from @i until @argc
+ *
+ * Returns: Sum of strlen()
+ */
+size_t slen_args(int argc, char **argv, int i, struct strview *args)
+{
+	size_t size = 0;
+
+	for (; i < argc; ++i, ++args) {
+		*args = strview_str(argv[i]);
+		size += args->len;
+	}
+
+	return size;
+}
+
+/**
+ * hash() - Quick and dirty switch-hack
+ *
+ * @c: A string
+ *
+ * To use a switch when selection the mode, @c needs to be a integer. For that
+ * we use this function to strcasecmp() @c to see which mode is requested.
+ *
+ * Returns: The mode-integer
+ */
+int hash(char *c)
+{
+	if (!strncasecmp(c, "left", 4)) {
+		return MODE_LEFT;
+	} else if (!strncasecmp(c, "right", 5)) {
+		return MODE_RIGHT;
+	} else if (!strncasecmp(c, "both", 4)) {
+		return MODE_BOTH;
+	} else if (!strncasecmp(c, "center", 6) ||
+		   !strncasecmp(c, "centre", 6)) {
+		return MODE_CENTRE;
+	}
+
+	return DEFAULT_MODE;
+}
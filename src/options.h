@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2023 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+#include <stddef.h>
+#include "fields.h"
+#include "strbuf.h"
+
+#define PACKAGE "pad"
+#define VERSION "0.5.1"
+#define PACKAGE_BUGREPORT "zocker@10zen.eu"
+
+// Defaults if not specified by commandline
+#define DEFAULT_LENGTH 80
+#define DEFAULT_CHAR " "
+#define DEFAULT_MODE MODE_BOTH
+
+// Upper limit for -j
+#define MAX_JOBS 1024
+
+// Upper limit for --cache
+#define MAX_CACHE (1 << 24)
+
+/**
+ * struct options - All commandline options
+ *
+ * @length: Length of the final string
+ * @padding_char: Char to pad with
+ * @mode: How to pad, with MODE_COLUMNS for -w, MODE_ANSI for -a and
+ * MODE_GRAPHEMES for --graphemes, MODE_TRUNCATE and MODE_ELLIPSIS for
+ * --truncate and --ellipsis
+ * @s: What to pad
+ * @s_len: Length of @s in bytes
+ * @err: 1 if help was asked for, 2 if parsing was aborted
+ * @merged_argv: Arguments after --, merged into one string
+ * @stream: Pad every line of stdin instead of @s
+ * @delim: Record separator for @stream
+ * @jobs: Number of threads padding @stream
+ * @file: Pad the records of this file instead of stdin
+ * @serve: Answer framed requests, see serve.h
+ * @socket: Answer them on this Unix socket instead of stdin and stdout
+ * @cache: Number of padded records of @stream to keep, 0 for none
+ * @cache_stats: Print the hits and misses of @cache to stderr
+ * @fields: Pad these fields of every record of @stream instead, if any
+ * @auto_width: Pad to the widest record, or field, of @stream instead of
+ * @length
+ */
+struct options {
+	size_t length;
+	char *padding_char;
+	int mode;
+	char *s;
+	size_t s_len;
+	int err;
+	char *merged_argv;
+	int stream;
+	char delim;
+	int jobs;
+	char *file;
+	int serve;
+	char *socket;
+	size_t cache;
+	int cache_stats;
+	struct fields fields;
+	int auto_width;
+};
+
+// arena, number of arguments, argument array
+struct options *parse(struct arena *, int, char **);
+void options_free(struct options *);
+size_t options_size(struct options *, int);
+// options, size of result, file --auto-width may spill to or -1
+int options_run_stream(struct options *, size_t, int);
+int option_takes_value(const char *);
+char *last_standalone(int, char **);
+int hash(char *);
+void print_usage(void);
+int get_winsize(void);
+int ceildiv(int, int);
+char *merge_argv(struct arena *, int, char **, int, size_t *);
+size_t slen_args(int, char **, int, struct strview *);
+
+#endif
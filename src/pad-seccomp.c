@@ -15,6 +15,12 @@
 #include <errno.h>
 #include <linux/sched.h> /* for clone filter */
 #include <fcntl.h>
+#include <sys/mman.h> /* PROT_EXEC */
+
+/* only visible with _GNU_SOURCE */
+#ifndef AT_EMPTY_PATH
+#define AT_EMPTY_PATH 0x1000
+#endif
 
 #define ADD_RULE(str_action, action, call, ...)                               \
 	do {                                                                  \
@@ -29,9 +35,13 @@
 #define ALLOW_ONLY_RULE(call, ...) ADD_RULE("allow", SCMP_ACT_ALLOW, call, 1, __VA_ARGS__)
 #define ERRNO_RULE(call) ADD_RULE("errno", SCMP_ACT_ERRNO(ENOSYS), call, 0)
 #define CMP_READ_ONLY SCMP_CMP(2, SCMP_CMP_MASKED_EQ, O_RDONLY, 0)
-#define CMP_WRITE_FD(fd) SCMP_CMP(0, SCMP_CMP_EQ, fd)
+#define CMP_FD(fd) SCMP_CMP(0, SCMP_CMP_EQ, fd)
+#define CMP_NO_EXEC SCMP_CMP(2, SCMP_CMP_MASKED_EQ, PROT_EXEC, 0)
+#define CMP_THREAD SCMP_CMP(0, SCMP_CMP_MASKED_EQ, CLONE_THREAD, CLONE_THREAD)
+#define CMP_EMPTY_PATH \
+	SCMP_CMP(3, SCMP_CMP_MASKED_EQ, AT_EMPTY_PATH, AT_EMPTY_PATH)
 
-int enable_seccomp(void)
+int enable_seccomp(int flags, int spill)
 {
 	/* prevent child processes from getting more priv e.g. via setuid, capabilities, ... */
 	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0)) {
@@ -53,15 +63,80 @@ int enable_seccomp(void)
 	ALLOW_RULE(close);
 	ALLOW_RULE(exit);
 	ALLOW_RULE(exit_group);
-	ALLOW_RULE(read);
 	ALLOW_RULE(brk);
 	ALLOW_RULE(fstat);
+	/* which glibc 2.33 and later make fstat() with */
+	ALLOW_ONLY_RULE(newfstatat, CMP_EMPTY_PATH);
+	ALLOW_RULE(munmap);
+	ALLOW_RULE(mremap);
+
+	/* --socket reads no more than stdin, its clients with recv() */
+	if (!(flags & SANDBOX_SOCKET)) {
+		ALLOW_RULE(read);
+	}
 
 	/* Specific rules */
 	ALLOW_ONLY_RULE(open, CMP_READ_ONLY);
 	ALLOW_ONLY_RULE(openat, CMP_READ_ONLY);
-	ALLOW_ONLY_RULE(write, CMP_WRITE_FD(1));
-	ALLOW_ONLY_RULE(write, CMP_WRITE_FD(2));
+	ALLOW_ONLY_RULE(write, CMP_FD(1));
+	ALLOW_ONLY_RULE(write, CMP_FD(2));
+	ALLOW_ONLY_RULE(writev, CMP_FD(1));
+	/* waiting for a non-blocking stdout to take more, glibc may use either */
+	ALLOW_RULE(poll);
+	ALLOW_RULE(ppoll);
+	/* malloc() serves large allocations (stream buffers, long paddings)
+	 * with mmap */
+	ALLOW_ONLY_RULE(mmap, CMP_NO_EXEC);
+
+	/* thread stacks are given back with it, -f and --auto-width hint at
+	 * reading the input in order */
+	if (flags & (SANDBOX_THREADS | SANDBOX_FILE | SANDBOX_SPILL)) {
+		ALLOW_RULE(madvise);
+	}
+
+	/* -j: pthread_create() and friends */
+	if (flags & SANDBOX_THREADS) {
+		ALLOW_RULE(futex);
+		ALLOW_RULE(set_robust_list);
+		ALLOW_RULE(rseq);
+		ALLOW_RULE(rt_sigprocmask);
+		/* guard pages of thread stacks and malloc() arenas */
+		ALLOW_ONLY_RULE(mprotect, CMP_NO_EXEC);
+		/* the flags of clone3() cannot be filtered, glibc falls back to clone() */
+		ERRNO_RULE(clone3);
+		ALLOW_ONLY_RULE(clone, CMP_THREAD);
+	}
+
+	/* the first pthread_create() installs the signal handlers of glibc,
+	 * -f starts threads for its parts, too */
+	if (flags & (SANDBOX_THREADS | SANDBOX_FILE)) {
+		ALLOW_RULE(rt_sigaction);
+	}
+
+	/* -f: the input is mapped, the output written at offsets */
+	if (flags & SANDBOX_FILE) {
+		ALLOW_ONLY_RULE(fcntl, CMP_FD(1));
+		ALLOW_ONLY_RULE(lseek, CMP_FD(1));
+		ALLOW_ONLY_RULE(ftruncate, CMP_FD(1));
+		ALLOW_ONLY_RULE(pwrite64, CMP_FD(1));
+	}
+
+	/* --socket: clients are only ever talked to with recv() and send() */
+	if (flags & SANDBOX_SOCKET) {
+		ALLOW_ONLY_RULE(read, CMP_FD(0));
+		ALLOW_RULE(accept);
+		ALLOW_RULE(accept4);
+		ALLOW_RULE(recvfrom);
+		ALLOW_RULE(sendto);
+	}
+
+	/* --auto-width: where stdin starts, if it is a file, or spilling it */
+	if (flags & SANDBOX_SPILL) {
+		ALLOW_ONLY_RULE(lseek, CMP_FD(0));
+		if (spill >= 0) {
+			ALLOW_ONLY_RULE(write, CMP_FD(spill));
+		}
+	}
 
 	/* applying filter... */
 	if (seccomp_load(ctx) >= 0) {
@@ -78,8 +153,10 @@ out:
 
 #else
 
-int enable_seccomp(void)
+int enable_seccomp(int flags, int spill)
 {
+	(void)flags;
+	(void)spill;
 	return 0;
 }
 
@@ -5,6 +5,13 @@
 #ifndef ZATHURA_SECCOMP_FILTERS_H
 #define ZATHURA_SECCOMP_FILTERS_H
 
-int enable_seccomp(void);
+/* what the filter has to allow on top of padding to stdout */
+#define SANDBOX_THREADS 0x01 /* -j */
+#define SANDBOX_FILE 0x02 /* -f */
+#define SANDBOX_SOCKET 0x04 /* --socket */
+#define SANDBOX_SPILL 0x08 /* --auto-width */
+
+/* spill is the file --auto-width may write its input to, or -1 */
+int enable_seccomp(int flags, int spill);
 
 #endif
@@ -2,46 +2,231 @@
 //
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <errno.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
-#include <stdio.h>
 #include "wee-utf8.h" // stolen from Weechat (https://weechat.org)
+#include "simd.h"
+#include "width.h"
+#include "ansi.h"
+#include "grapheme.h"
 #include "padding.h"
 
 /**
- * pad_left() - Left pad a string
+ * fill_char() - Encode a padding character
+ *
+ * @c: Set to the encoded character, CHAR_WIDTH bytes
+ * @p: The padding character
+ *
+ * The number of bytes follows from the code point, so @c is not scanned for
+ * its end afterwards.
+ *
+ * Returns: Number of bytes in @c
+ */
+static size_t fill_char(char *c, const char *p)
+{
+	unsigned int cp = utf8_char_int(p);
+
+	memset(c, 0, CHAR_WIDTH);
+	utf8_int_string(cp, c);
+
+	if (!cp)
+		return 0;
+
+	return (cp <= 0x7f) ? 1 : (cp <= 0x7ff) ? 2 : (cp <= 0xffff) ? 3 : 4;
+}
+
+/**
+ * pad_view_layout() - Lay out a padded view
+ *
+ * @mode: Padding mode
+ * @v: The string
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @l: Set to the layout
+ *
+ * Like pad_layout(), but if @v already knows how many characters it has and
+ * they are what @mode measures, they are not counted again. Neither are they
+ * if @v has to be cut, which takes pad_layout() as it is.
+ */
+static void pad_view_layout(int mode, struct strview v, size_t size,
+			    struct pad_layout *l)
+{
+	int measure = mode & (MODE_COLUMNS | MODE_ANSI | MODE_GRAPHEMES);
+	int cut = (mode & MODE_TRUNCATE) && (mode & MODE_MASK) != MODE_CENTRE;
+
+	if (v.chars == STRVIEW_UNKNOWN || measure || (cut && v.chars > size)) {
+		pad_layout(mode, v.data, v.len, size, l);
+		return;
+	}
+
+	*l = (struct pad_layout){ .len = v.len, .tail = v.len };
+	pad_counts(mode, v.chars, size, &l->left, &l->right);
+}
+
+/**
+ * pad_view() - Pad a view into a caller-provided buffer
+ *
+ * @out: Buffer to hold the padded string, may be NULL if @outsize is 0
+ * @outsize: Size of @out in bytes
+ * @mode: One of MODE_LEFT, MODE_RIGHT, MODE_BOTH or MODE_CENTRE, optionally
+ * with any of MODE_FLAGS
+ * @v: The string that shall be padded, it may contain NUL bytes
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @padding_char: Padding character
+ *
+ * This is the core of the library. It neither allocates nor prints anything
+ * and only touches @out, so it can be called from any number of threads at
+ * once. The result is laid out with pad_view_layout() first and only written
+ * if it fits into @out as a whole, followed by a NUL byte if there is room
+ * for one. Call it with an @outsize of 0 to learn how large @out has to be.
+ * @v is only read where it is measured and where it is copied, never to look
+ * for its end.
+ *
+ * Returns: Size of the padded string in bytes, without the final NUL byte. If
+ * this is larger than @outsize, nothing was written.
+ */
+size_t pad_view(char *out, size_t outsize, int mode, struct strview v,
+		size_t size, const char *padding_char)
+{
+	struct pad_fill f;
+	struct pad_layout l;
+
+	f.width = fill_char(f.c, padding_char);
+	pad_view_layout(mode, v, size, &l);
+
+	size_t need = pad_layout_size(&l, f.width);
+
+	if (!out || need > outsize)
+		return need;
+
+	pad_layout_copy(out, &l, v.data, &f);
+
+	if (need < outsize)
+		out[need] = '\0';
+
+	return need;
+}
+
+/**
+ * pad_alloc() - Pad a view into memory from an arena
+ *
+ * @a: The arena
+ * @mode: One of MODE_LEFT, MODE_RIGHT, MODE_BOTH or MODE_CENTRE, optionally
+ * with any of MODE_FLAGS
+ * @v: The string that shall be padded
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @padding_char: Padding character
+ * @len: Set to the size of the padded string in bytes
+ *
+ * Like pad_view(), but the result is laid out once and gets exactly as much
+ * of @a as it takes, instead of a buffer that may be too small. Callers that
+ * pad one string after the other reset @a in between, so none of them costs
+ * a heap allocation once @a is large enough.
+ *
+ * Returns:
+ * * The padded string, followed by a NUL byte
+ * * NULL on allocation failure, with errno set
+ */
+char *pad_alloc(struct arena *a, int mode, struct strview v, size_t size,
+		const char *padding_char, size_t *len)
+{
+	struct pad_fill f;
+	struct pad_layout l;
+
+	f.width = fill_char(f.c, padding_char);
+	pad_view_layout(mode, v, size, &l);
+
+	size_t need = pad_layout_size(&l, f.width);
+	char *out = arena_alloc(a, need + 1);
+
+	if (!out)
+		return NULL;
+
+	*pad_layout_copy(out, &l, v.data, &f) = '\0';
+	*len = need;
+	return out;
+}
+
+/**
+ * pad_buf() - Pad a string into a caller-provided buffer
  *
+ * @out: Buffer to hold the padded string, may be NULL if @outsize is 0
+ * @outsize: Size of @out in bytes
+ * @mode: One of MODE_LEFT, MODE_RIGHT, MODE_BOTH or MODE_CENTRE, optionally
+ * with any of MODE_FLAGS
  * @s: The string that shall be padded
- * @size: Size of the padded string
+ * @len: Length of @s in bytes
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @padding_char: Padding character
+ *
+ * pad_view() for callers that keep the string and its length apart.
+ *
+ * Returns: See pad_view()
+ */
+size_t pad_buf(char *out, size_t outsize, int mode, const char *s,
+	       size_t len, size_t size, const char *padding_char)
+{
+	return pad_view(out, outsize, mode, strview_bytes(s, len), size,
+			padding_char);
+}
+
+/**
+ * pad_strbuf() - Pad a view onto a strbuf
+ *
  * @p: Buffer to hold the padded string
+ * @mode: Padding mode
+ * @v: The string that shall be padded
+ * @size: Size of the padded string
  * @padding_char: Padding character
  *
- * We crate a string that holds @padding_characcter @size times (minus the length
- * of @s) and cat it onto @p so that we get a string of the form <PADDING>@s.
+ * pad_view() into the space left in @p. If the result does not fit, @p is
+ * grown to what pad_view() asks for and it is padded again, if @p grows,
+ * see strbuf_alloc(). Otherwise nothing is written and @p is marked as
+ * overflowed.
  *
  * Returns:
  * * 0 on success
- * * 1 on failure or strbuf overflow
+ * * 1 on strbuf overflow, or if @p could not grow
  */
-int pad_left(char *s, size_t size, struct strbuf *p, char *padding_char)
+static int pad_strbuf(struct strbuf *p, int mode, struct strview v,
+		      size_t size, const char *padding_char)
 {
-	size_t slen = utf8_strnlen(s, size + CHAR_WIDTH);
-	if (slen >= (size_t)size) {
-		strbuf_cat(p, s);
-		return strbuf_has_overflowed(p);
-	}
+	char *data = NULL;
+	size_t left = strbuf_get_buf(p, &data);
+	size_t n = pad_view(data, left, mode, v, size, padding_char);
 
-	char *buf = padding(size - slen + 1, padding_char);
+	if (n > left) {
+		if (strbuf_reserve(p, n))
+			return 1;
 
-	if (!buf) {
-		return 0;
+		pad_view(p->data + p->len, n, mode, v, size, padding_char);
 	}
 
-	strbuf_cat(p, buf);
-	strbuf_cat(p, s);
+	p->len += n;
+	return 0;
+}
 
-	free(buf);
-	return strbuf_has_overflowed(p);
+/**
+ * pad_left() - Left pad a string
+ *
+ * @s: The string that shall be padded
+ * @size: Size of the padded string
+ * @p: Buffer to hold the padded string
+ * @padding_char: Padding character
+ *
+ * Put @padding_char in front of @s as often as it takes for @s to be @size
+ * characters long, so that we get a string of the form <PADDING>@s. If the
+ * result does not fit into @p, nothing is written.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on strbuf overflow
+ */
+int pad_left(struct strview s, size_t size, struct strbuf *p,
+	     const char *padding_char)
+{
+	return pad_strbuf(p, MODE_LEFT, s, size, padding_char);
 }
 
 /**
@@ -56,32 +241,14 @@ int pad_left(char *s, size_t size, struct strbuf *p, char *padding_char)
  *
  * Returns:
  * * 0 on success
- * * 1 on failure or strbuf overflow
+ * * 1 on strbuf overflow
  *
  * See pad_left()
  */
-int pad_both(char *s, size_t size, struct strbuf *p, char *padding_char)
+int pad_both(struct strview s, size_t size, struct strbuf *p,
+	     const char *padding_char)
 {
-	size_t slen = utf8_strnlen(s, size + CHAR_WIDTH);
-	if (slen >= (size_t)size) {
-		strbuf_cat(p, s);
-		return strbuf_has_overflowed(p);
-	}
-	int b_size = (size - slen) / 2;
-
-	char *buf = padding(b_size + 1, padding_char);
-
-	if (!buf) {
-		return 0;
-	}
-
-	strbuf_cat(p, buf);
-	strbuf_cat(p, s);
-	strbuf_cat(p, buf);
-
-	free(buf);
-
-	return strbuf_has_overflowed(p);
+	return pad_strbuf(p, MODE_BOTH, s, size, padding_char);
 }
 
 /**
@@ -96,84 +263,373 @@ int pad_both(char *s, size_t size, struct strbuf *p, char *padding_char)
  *
  * Returns:
  * * 0 on success
- * * 1 on failure or strbuf overflow
+ * * 1 on strbuf overflow
+ *
+ * See pad_left()
+ */
+int pad_right(struct strview s, size_t size, struct strbuf *p,
+	      const char *padding_char)
+{
+	return pad_strbuf(p, MODE_RIGHT, s, size, padding_char);
+}
+
+/**
+ * pad_mode() - Pad a string according to a mode
+ *
+ * @mode: One of MODE_LEFT, MODE_RIGHT, MODE_BOTH or MODE_CENTRE
+ * @s: The string that shall be padded
+ * @size: Size of the padded string
+ * @p: Buffer to hold the padded string
+ * @padding_char: Padding character
+ *
+ * Like pad_left(), pad_right() or pad_both(). For MODE_CENTRE @size is not
+ * the size of the padded string, but the number of padding characters to put
+ * in front of @s, i.e. the already computed offset of @s on the terminal.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on strbuf overflow
  *
  * See pad_left()
  */
-int pad_right(char *s, size_t size, struct strbuf *p, char *padding_char)
+int pad_mode(int mode, struct strview s, size_t size, struct strbuf *p,
+	     const char *padding_char)
 {
-	size_t slen = utf8_strnlen(s, size + CHAR_WIDTH);
-	if (slen >= (size_t)size) {
-		strbuf_cat(p, s);
-		return strbuf_has_overflowed(p);
+	return pad_strbuf(p, mode, s, size, padding_char);
+}
+
+/**
+ * padding_width() - Number of bytes a padding character takes up
+ *
+ * @p: The padding character
+ *
+ * Returns: Length of @p once encoded like fill_encode() does, in bytes
+ */
+size_t padding_width(const char *p)
+{
+	char tmp[CHAR_WIDTH];
+
+	return fill_char(tmp, p);
+}
+
+/**
+ * text_prefix() - Longest start of a string without escape sequences
+ *
+ * @mode: Padding mode
+ * @s: The string
+ * @len: Length of @s in bytes
+ * @max: Length the start may have
+ * @n: Set to the length it has
+ *
+ * The length is the number of terminal columns with MODE_COLUMNS, see
+ * utf8_width_prefix(), the number of characters otherwise, see
+ * simd_utf8_prefix(). With MODE_GRAPHEMES, a grapheme cluster counts as one
+ * character, and takes the columns of its widest one, see grapheme_prefix().
+ *
+ * Returns: Length of the start in bytes, @len if all of @s fits
+ */
+static size_t text_prefix(int mode, const char *s, size_t len, size_t max,
+			  size_t *n)
+{
+	if (mode & MODE_GRAPHEMES)
+		return grapheme_prefix(s, len, mode & MODE_COLUMNS, max, n);
+
+	if (mode & MODE_COLUMNS)
+		return utf8_width_prefix(s, len, max, n);
+
+	return simd_utf8_prefix(s, len, max, n);
+}
+
+/**
+ * pad_prefix() - Longest start of a string within a length
+ *
+ * @mode: Padding mode
+ * @s: The string
+ * @len: Length of @s in bytes
+ * @max: Length the start may have
+ * @n: Set to the length it has
+ *
+ * This measures and cuts in one go, front to back, and stops where the
+ * start ends, so only as much of @s is looked at as is kept. The cut falls
+ * between two characters, or columns or grapheme clusters, see
+ * text_prefix(). With MODE_ANSI, simd_find_byte() jumps from one escape
+ * sequence to the next and only the text between them is measured, so
+ * a string without any costs one more scan for ANSI_ESC. The sequences
+ * themselves take no room, see ansi_escape() for which ones are known. One
+ * that does not end takes the rest of @s.
+ *
+ * Returns: Length of the start in bytes, @len if all of @s fits
+ */
+size_t pad_prefix(int mode, const char *s, size_t len, size_t max, size_t *n)
+{
+	if (!(mode & MODE_ANSI))
+		return text_prefix(mode, s, len, max, n);
+
+	const char *p = s;
+	const char *end = s + len;
+
+	*n = 0;
+
+	for (;;) {
+		const char *e = simd_find_byte(p, end - p, ANSI_ESC);
+		size_t text = (e ? e : end) - p;
+		size_t m;
+		size_t keep = text_prefix(mode, p, text, max - *n, &m);
+
+		*n += m;
+		p += keep;
+		if (keep < text || !e)
+			return p - s;
+
+		size_t skip = ansi_escape(e, end - e);
+
+		p = skip ? e + skip : end;
 	}
+}
 
-	char *buf = padding(size - slen + 1, padding_char);
+/**
+ * pad_length() - Length of a string, as far as padding it is concerned
+ *
+ * @mode: Padding mode
+ * @s: The string
+ * @len: Length of @s in bytes
+ *
+ * Returns: Length of @s as pad_prefix() measures it, and 0 for MODE_CENTRE,
+ * which does not care about the length of @s
+ */
+size_t pad_length(int mode, const char *s, size_t len)
+{
+	size_t n;
 
-	if (!buf) {
+	if ((mode & MODE_MASK) == MODE_CENTRE)
 		return 0;
+
+	// Nothing to cut, so just count
+	if (!(mode & (MODE_COLUMNS | MODE_ANSI | MODE_GRAPHEMES)))
+		return simd_utf8_count(s, len);
+
+	pad_prefix(mode, s, len, SIZE_MAX, &n);
+	return n;
+}
+
+/**
+ * pad_layout() - Lay out a padded string
+ *
+ * @mode: Padding mode
+ * @s: The string
+ * @len: Length of @s in bytes
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @l: Set to the layout
+ *
+ * Without MODE_TRUNCATE, or for MODE_CENTRE, this is all of @s with the
+ * padding pad_counts() asks for around it, and @s is measured with
+ * pad_length(). With it, a string longer than @size is cut down to it with
+ * pad_prefix() instead, in the same pass over @s. For MODE_ELLIPSIS the cut
+ * leaves room for ELLIPSIS, and whether @s fits after all is found out by
+ * going on from there. A string cut in columns may fall short of @size, so
+ * it is still padded. For MODE_ANSI the escape sequences @s ends with are
+ * kept after the cut, so e.g. the color is still reset.
+ */
+void pad_layout(int mode, const char *s, size_t len, size_t size,
+		struct pad_layout *l)
+{
+	size_t slen;
+
+	*l = (struct pad_layout){ .len = len, .tail = len };
+
+	if (!(mode & MODE_TRUNCATE) || (mode & MODE_MASK) == MODE_CENTRE) {
+		pad_counts(mode, pad_length(mode, s, len), size, &l->left,
+			   &l->right);
+		return;
 	}
 
-	strbuf_cat(p, s);
-	strbuf_cat(p, buf);
+	size_t room = (mode & MODE_ELLIPSIS) && size ? size - 1 : size;
+	size_t cut = pad_prefix(mode, s, len, room, &slen);
 
-	free(buf);
+	if (cut < len && room < size) {
+		size_t more;
 
-	return strbuf_has_overflowed(p);
+		if (pad_prefix(mode, s + cut, len - cut, size - slen, &more) ==
+		    len - cut) {
+			cut = len;
+			slen += more;
+		}
+	}
+
+	if (cut < len) {
+		l->len = cut;
+		if (room < size) {
+			l->ellipsis = 1;
+			++slen;
+		}
+		if (mode & MODE_ANSI) {
+			l->tail = cut + ansi_tail(s + cut, len - cut);
+			l->tail_len = len - l->tail;
+		}
+	}
+
+	pad_counts(mode, slen, size, &l->left, &l->right);
 }
 
 /**
- * padding() - Create a padding string
+ * pad_layout_size() - Exact size of a laid out string
  *
- * @size: Length of the padding string
- * @p: The character to create the padding string with
+ * @l: The layout
+ * @width: Bytes per padding character, see padding_width()
  *
- * First we calculate how much space the padding string will take by checking
- * if @p is of length one or of utf8-length one and then multiplying by both @size
- * and strnlen(). Then we copy @p into the buffer @size times.
+ * Returns: The number of bytes pad_layout_copy() writes
+ */
+size_t pad_layout_size(const struct pad_layout *l, size_t width)
+{
+	return (l->left + l->right) * width + l->len +
+	       (l->ellipsis ? ELLIPSIS_LEN : 0) + l->tail_len;
+}
+
+/**
+ * pad_layout_copy() - Write out a laid out string
  *
- * Returns:
- * * A padded string
- * * NULL on any error
+ * @dst: Where it goes, pad_layout_size() bytes
+ * @l: The layout
+ * @s: The string
+ * @f: The fill to pad with, only its character is used
+ *
+ * Returns: @dst, moved past the string
  */
-char *padding(size_t size, char *p)
+char *pad_layout_copy(char *dst, const struct pad_layout *l, const char *s,
+		      const struct pad_fill *f)
 {
-	char *tmp = calloc(CHAR_WIDTH, sizeof(char));
+	simd_fill(dst, l->left * f->width, f->c, f->width);
+	dst += l->left * f->width;
 
-	if (!tmp) {
-		perror("pad - padding");
-		return NULL;
+	memcpy(dst, s, l->len);
+	dst += l->len;
+
+	if (l->ellipsis) {
+		memcpy(dst, ELLIPSIS, ELLIPSIS_LEN);
+		dst += ELLIPSIS_LEN;
 	}
 
-	utf8_int_string(utf8_char_int(p), tmp);
+	memcpy(dst, s + l->tail, l->tail_len);
+	dst += l->tail_len;
 
-	int tmp_len = strnlen(tmp, CHAR_WIDTH);
-	// Size is # chars, not # bytes --- so if we have an utf8 'char'
-	// of length 1, that is not also strlen 1, we multiply size
-	// by the length of the string (that is the # bytes in the
-	// string)
-	if (utf8_strnlen(tmp, CHAR_WIDTH) == 1 && tmp_len != 1)
-		size *= tmp_len;
+	simd_fill(dst, l->right * f->width, f->c, f->width);
+	return dst + l->right * f->width;
+}
+
+/**
+ * pad_counts() - Number of padding characters on either side of a string
+ *
+ * @mode: One of MODE_LEFT, MODE_RIGHT, MODE_BOTH or MODE_CENTRE
+ * @slen: Length of the string, see pad_length()
+ * @size: Size of the padded string (left offset for MODE_CENTRE)
+ * @left: Set to the number of padding characters in front of the string
+ * @right: Set to the number of padding characters after the string
+ *
+ * This is the layout pad_left(), pad_right(), pad_both() and pad_mode()
+ * produce, for callers that emit the padding themselves.
+ */
+void pad_counts(int mode, size_t slen, size_t size, size_t *left,
+		size_t *right)
+{
+	*left = 0;
+	*right = 0;
+	mode &= MODE_MASK;
 
-	char *s = calloc(size + 1, sizeof(char));
+	if (mode == MODE_CENTRE) {
+		*left = size;
+		return;
+	}
 
-	if (!s) {
-		perror("pad - padding");
-		free(tmp);
+	if (slen >= size)
+		return;
 
-		return NULL;
+	switch (mode) {
+	case MODE_LEFT:
+		*left = size - slen;
+		break;
+	case MODE_RIGHT:
+		*right = size - slen;
+		break;
+	default:
+		*left = (size - slen) / 2;
+		*right = *left;
 	}
+}
 
-	// Copy the 'character' into 's'
-	// Cannot use strncat since that fucks the string up
-	// and since the 'character' may be multi-byte, we can't
-	// just do 's[i] = tmp' :(
-	for (size_t i = 0; i < size - tmp_len; i += tmp_len)
-		for (int j = 0; j < tmp_len; ++j)
-			s[i + j] = tmp[j];
-	s[size] = '\0';
+/**
+ * fill_encode() - Encode a padding character, without a fill block
+ *
+ * @f: The fill to initialise
+ * @p: The character to pad with
+ *
+ * This is all pad_layout_copy() needs of @f, and nothing has to be freed.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 with errno set to EINVAL if @p is empty
+ */
+int fill_encode(struct pad_fill *f, const char *p)
+{
+	f->block = NULL;
+	f->chars = 0;
+	f->width = fill_char(f->c, p);
 
-	free(tmp);
+	if (!f->width) {
+		errno = EINVAL;
+		return 1;
+	}
 
-	return s;
+	return 0;
+}
+
+/**
+ * fill_init() - Create a shared fill block
+ *
+ * @f: The fill to initialise
+ * @p: The character to pad with
+ * @max: Largest number of padding characters needed at once
+ *
+ * Encode @p with fill_encode() and repeat it as often as @max asks for, but
+ * never beyond FILL_BLOCK bytes. The block is built once with simd_fill() and
+ * is only read from afterwards, so every padding run of every record can
+ * point into it instead of building a padding string of its own. Runs longer
+ * than the block just point into it several times: padding to any length
+ * takes no more than FILL_BLOCK bytes.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure, with errno set
+ * * 1 with errno set to EINVAL if @p is empty
+ */
+int fill_init(struct pad_fill *f, char *p, size_t max)
+{
+	if (fill_encode(f, p))
+		return 1;
+
+	f->chars = FILL_BLOCK / f->width;
+
+	if (max && max < f->chars)
+		f->chars = max;
+
+	size_t bytes = f->chars * f->width;
+	char *block = malloc(bytes);
+
+	if (!block)
+		return 1;
+
+	simd_fill(block, bytes, f->c, f->width);
+
+	f->block = block;
+	return 0;
+}
+
+/**
+ * fill_free() - Free a shared fill block
+ *
+ * @f: The fill
+ */
+void fill_free(struct pad_fill *f)
+{
+	free((char *)f->block);
+	f->block = NULL;
 }
@@ -6,10 +6,112 @@
 #define PADDING_H
 #include "strbuf.h"
 
+#define MODE_LEFT 0x00
+#define MODE_RIGHT 0x01
+#define MODE_BOTH 0x02
+#define MODE_CENTRE 0x03
+// Or'd into any of the above but MODE_CENTRE: cut strings longer than the
+// size of the result down to it
+#define MODE_TRUNCATE 0x04
+// Or'd in, too: end a cut string with ELLIPSIS
+#define MODE_ELLIPSIS 0x08
+// Or'd into any of the above: measure strings in terminal columns instead of
+// characters, so wide characters line up
+#define MODE_COLUMNS 0x10
+// Or'd in, too: skip ANSI escape sequences when measuring, so colored strings
+// line up
+#define MODE_ANSI 0x20
+// Or'd in, too: count grapheme clusters instead of characters, or with
+// MODE_COLUMNS take the width of every cluster once
+#define MODE_GRAPHEMES 0x40
+#define MODE_MASK 0x03
+#define MODE_FLAGS (MODE_TRUNCATE | MODE_ELLIPSIS | MODE_COLUMNS | MODE_ANSI | \
+		    MODE_GRAPHEMES)
+
+// U+2026, one character and one column
+#define ELLIPSIS "\xe2\x80\xa6"
+#define ELLIPSIS_LEN 3
+
+// Size of the buffers short strings are padded in on the stack, before
+// anything is allocated. A string of 128 bytes padded to 200 columns of
+// 4 byte characters fits.
+#ifndef PAD_STACK
+#define PAD_STACK 1024
+#endif
+
+// Maximum size of a shared fill block in bytes. Longer padding runs are
+// written in chunks of this size, so memory use does not grow with -l.
+#define FILL_BLOCK (64 << 10)
+
+/**
+ * struct pad_fill - A padding character, repeated
+ *
+ * @c: The encoded padding character
+ * @width: Number of bytes in @c
+ * @block: @c repeated @chars times, shared by everything that pads with @c
+ * @chars: Number of characters in @block
+ */
+struct pad_fill {
+	char c[CHAR_WIDTH];
+	size_t width;
+	const char *block;
+	size_t chars;
+};
+
+/**
+ * struct pad_layout - What a padded string is made of, see pad_layout()
+ *
+ * @left: Number of padding characters in front of the string
+ * @len: Number of bytes of the string to keep, less than all of them if it
+ * was cut
+ * @ellipsis: Set if ELLIPSIS follows them
+ * @tail: Offset of more bytes of the string to keep after the cut
+ * @tail_len: Number of bytes at @tail, 0 if none
+ * @right: Number of padding characters after the string
+ */
+struct pad_layout {
+	size_t left;
+	size_t len;
+	int ellipsis;
+	size_t tail;
+	size_t tail_len;
+	size_t right;
+};
+
+// result buffer, its size, mode, input, size of result (left offset for
+// MODE_CENTRE), padding
+size_t pad_view(char *, size_t, int, struct strview, size_t, const char *);
+// arena, mode, input, size of result (left offset for MODE_CENTRE), padding,
+// set to the length of the result
+char *pad_alloc(struct arena *, int, struct strview, size_t, const char *,
+		size_t *);
+// result buffer, its size, mode, input, length of input in bytes, size of
+// result (left offset for MODE_CENTRE), padding
+size_t pad_buf(char *, size_t, int, const char *, size_t, size_t,
+	       const char *);
 // input, size of result, result string, padding
-int pad_left(char *, size_t, struct strbuf *, char *);
-int pad_right(char *, size_t, struct strbuf *, char *);
-int pad_both(char *, size_t, struct strbuf *, char *);
-char *padding(size_t, char *);
+int pad_left(struct strview, size_t, struct strbuf *, const char *);
+int pad_right(struct strview, size_t, struct strbuf *, const char *);
+int pad_both(struct strview, size_t, struct strbuf *, const char *);
+// mode, input, size of result (left offset for MODE_CENTRE), result string,
+// padding
+int pad_mode(int, struct strview, size_t, struct strbuf *, const char *);
+size_t padding_width(const char *);
+// mode, input, length of input in bytes
+size_t pad_length(int, const char *, size_t);
+// mode, input, length of input in bytes, length, set to the length taken
+size_t pad_prefix(int, const char *, size_t, size_t, size_t *);
+// mode, input, length of input in bytes, size of result, layout
+void pad_layout(int, const char *, size_t, size_t, struct pad_layout *);
+// layout, bytes per padding char
+size_t pad_layout_size(const struct pad_layout *, size_t);
+// result buffer, layout, input, fill
+char *pad_layout_copy(char *, const struct pad_layout *, const char *,
+		      const struct pad_fill *);
+// mode, length of input in chars, size of result, left count, right count
+void pad_counts(int, size_t, size_t, size_t *, size_t *);
+int fill_encode(struct pad_fill *, const char *);
+int fill_init(struct pad_fill *, char *, size_t);
+void fill_free(struct pad_fill *);
 
 #endif
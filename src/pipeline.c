@@ -0,0 +1,485 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "padding.h"
+#include "emit.h"
+#include "simd.h"
+#include "stream.h"
+#include "pipeline.h"
+
+#define CHUNK_FREE 0x00
+#define CHUNK_READ 0x01
+#define CHUNK_PADDED 0x02
+
+/**
+ * struct chunk - A run of complete records and its padded output
+ *
+ * @in: The records, each followed by the separator, but maybe the last
+ * @in_size: Size of @in
+ * @in_len: Number of bytes in @in that belong to this chunk
+ * @out: The padded records, grows as needed
+ * @state: CHUNK_FREE, CHUNK_READ or CHUNK_PADDED
+ */
+struct chunk {
+	char *in;
+	size_t in_size;
+	size_t in_len;
+	struct strbuf out;
+	int state;
+};
+
+/**
+ * struct pipeline - State shared by the reader, the workers and the writer
+ *
+ * @lock: Protects everything below, but the contents of the chunks
+ * @cond: Signalled whenever a chunk changes its state, or on @eof or @err
+ * @chunks: Ring of chunks, chunk n of the input is @chunks[n % @nchunks]
+ * @nchunks: Number of chunks in the ring
+ * @read: Number of chunks read so far
+ * @padded: Number of chunks handed to a worker so far
+ * @written: Number of chunks written so far
+ * @eof: Set once the reader is done
+ * @err: Set once anyone failed, everybody stops then
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @fill: The padding character, shared by all workers
+ * @delim: Record separator
+ */
+struct pipeline {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct chunk *chunks;
+	size_t nchunks;
+	size_t read;
+	size_t padded;
+	size_t written;
+	int eof;
+	int err;
+	int mode;
+	size_t size;
+	struct pad_fill fill;
+	char delim;
+};
+
+/**
+ * pipeline_fail() - Make every thread of the pipeline stop
+ *
+ * @pl: The pipeline
+ */
+static void pipeline_fail(struct pipeline *pl)
+{
+	pthread_mutex_lock(&pl->lock);
+	pl->err = 1;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+}
+
+/**
+ * chunk_set_state() - Hand a chunk on to the next stage
+ *
+ * @pl: The pipeline
+ * @c: The chunk
+ * @state: Its new state
+ */
+static void chunk_set_state(struct pipeline *pl, struct chunk *c, int state)
+{
+	pthread_mutex_lock(&pl->lock);
+	c->state = state;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+}
+
+/**
+ * chunk_pad() - Pad every record of a chunk
+ *
+ * @pl: The pipeline
+ * @c: The chunk
+ *
+ * Like emit_pad() does for pad_stream(), we lay every record out with
+ * pad_layout(), but copy it into @c->out with pad_layout_copy(), followed by
+ * its separator. @c->out is grown with strbuf_reserve() as needed, and
+ * keeps its size for the next chunk. A last record without a separator,
+ * which only the last chunk can have, gets one.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure
+ */
+static int chunk_pad(struct pipeline *pl, struct chunk *c)
+{
+	const struct pad_fill *f = &pl->fill;
+	const char *s = c->in;
+	const char *end = c->in + c->in_len;
+
+	strbuf_clear(&c->out);
+
+	while (s < end) {
+		const char *d = simd_find_byte(s, end - s, pl->delim);
+		size_t len = (d ? d : end) - s;
+		struct pad_layout l;
+
+		pad_layout(pl->mode, s, len, pl->size, &l);
+
+		// One more for the separator
+		size_t need = pad_layout_size(&l, f->width) + 1;
+
+		if (strbuf_reserve(&c->out, need)) {
+			perror("pad - pipeline");
+			return 1;
+		}
+
+		char *o = pad_layout_copy(c->out.data + c->out.len, &l, s, f);
+
+		*o++ = pl->delim;
+		c->out.len = o - c->out.data;
+
+		if (!d)
+			break;
+
+		s = d + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * worker() - Pad chunks in whatever order they come in
+ *
+ * @arg: The pipeline
+ *
+ * Returns: NULL
+ */
+static void *worker(void *arg)
+{
+	struct pipeline *pl = arg;
+
+	pthread_mutex_lock(&pl->lock);
+	for (;;) {
+		if (pl->err || (pl->eof && pl->padded == pl->read))
+			break;
+
+		if (pl->padded == pl->read) {
+			pthread_cond_wait(&pl->cond, &pl->lock);
+			continue;
+		}
+
+		struct chunk *c = &pl->chunks[pl->padded++ % pl->nchunks];
+
+		pthread_mutex_unlock(&pl->lock);
+
+		if (chunk_pad(pl, c)) {
+			pipeline_fail(pl);
+			return NULL;
+		}
+
+		chunk_set_state(pl, c, CHUNK_PADDED);
+		pthread_mutex_lock(&pl->lock);
+	}
+	pthread_mutex_unlock(&pl->lock);
+
+	return NULL;
+}
+
+/**
+ * writer() - Write the padded chunks in the order they were read in
+ *
+ * @arg: The pipeline
+ *
+ * Returns: NULL
+ */
+static void *writer(void *arg)
+{
+	struct pipeline *pl = arg;
+	struct emitter e;
+
+	emit_init(&e, STDOUT_FILENO);
+
+	pthread_mutex_lock(&pl->lock);
+	for (;;) {
+		if (pl->err || (pl->eof && pl->written == pl->read))
+			break;
+
+		struct chunk *c = &pl->chunks[pl->written % pl->nchunks];
+
+		if (pl->written == pl->read || c->state != CHUNK_PADDED) {
+			pthread_cond_wait(&pl->cond, &pl->lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&pl->lock);
+
+		if (emit(&e, c->out.data, c->out.len) || emit_flush(&e)) {
+			pipeline_fail(pl);
+			return NULL;
+		}
+
+		pthread_mutex_lock(&pl->lock);
+		c->state = CHUNK_FREE;
+		++pl->written;
+		pthread_cond_broadcast(&pl->cond);
+	}
+	pthread_mutex_unlock(&pl->lock);
+
+	return NULL;
+}
+
+/**
+ * chunk_alloc() - Give a chunk its buffers
+ *
+ * @c: The chunk, still without them
+ *
+ * The reader calls this the first time it takes @c, so a short input only
+ * ever allocates the few chunks it fills, however many workers there are.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure
+ */
+static int chunk_alloc(struct chunk *c)
+{
+	c->in_size = STREAM_BLOCK;
+	c->in = malloc(c->in_size);
+
+	if (!c->in || strbuf_alloc(&c->out, STREAM_BLOCK)) {
+		perror("pad - pipeline");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * read_chunk() - Fill a chunk from a file descriptor
+ *
+ * @pl: The pipeline
+ * @fd: The file descriptor to read from
+ * @c: The chunk, @c->in_len bytes of it are already there
+ * @eof: Set to 1 once the end of @fd is reached
+ *
+ * We read until @c->in is full or @fd ends. A full chunk without a single
+ * separator is grown, so every chunk ends in at least one complete record.
+ * Only what was read since the last time it was full is searched for one.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int read_chunk(struct pipeline *pl, int fd, struct chunk *c, int *eof)
+{
+	size_t used = c->in_len;
+	// What is there already holds no separator, see reader()
+	size_t searched = used;
+
+	for (;;) {
+		if (used == c->in_size) {
+			if (simd_find_byte(c->in + searched, used - searched,
+					   pl->delim))
+				break;
+
+			searched = used;
+
+			char *tmp = realloc(c->in, c->in_size * 2);
+
+			if (!tmp) {
+				perror("pad - pipeline");
+				return 1;
+			}
+
+			c->in = tmp;
+			c->in_size *= 2;
+		}
+
+		ssize_t n = read(fd, c->in + used, c->in_size - used);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("pad - pipeline");
+			return 1;
+		}
+
+		if (!n) {
+			*eof = 1;
+			break;
+		}
+
+		used += n;
+	}
+
+	c->in_len = used;
+	return 0;
+}
+
+/**
+ * reader() - Slice the input into chunks
+ *
+ * @pl: The pipeline
+ * @fd: The file descriptor to read from
+ *
+ * Every chunk is cut after its last separator. The partial record behind it
+ * is copied to the front of the next chunk, straight from the one before:
+ * with at least two chunks in the ring, that one is not handed out again
+ * before we are done with it.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int reader(struct pipeline *pl, int fd)
+{
+	const char *carry = NULL;
+	size_t carry_len = 0;
+	int eof = 0;
+
+	while (!eof) {
+		struct chunk *c = &pl->chunks[pl->read % pl->nchunks];
+
+		pthread_mutex_lock(&pl->lock);
+		while (!pl->err && c->state != CHUNK_FREE)
+			pthread_cond_wait(&pl->cond, &pl->lock);
+		int err = pl->err;
+		pthread_mutex_unlock(&pl->lock);
+
+		if (err || (!c->in && chunk_alloc(c)))
+			return 1;
+
+		while (c->in_size <= carry_len) {
+			char *tmp = realloc(c->in, c->in_size * 2);
+
+			if (!tmp) {
+				perror("pad - pipeline");
+				return 1;
+			}
+
+			c->in = tmp;
+			c->in_size *= 2;
+		}
+
+		// carry is still NULL for the first chunk
+		if (carry_len)
+			memcpy(c->in, carry, carry_len);
+		c->in_len = carry_len;
+
+		if (read_chunk(pl, fd, c, &eof))
+			return 1;
+
+		carry_len = 0;
+		if (!eof) {
+			const char *d =
+				simd_rfind_byte(c->in, c->in_len, pl->delim);
+
+			carry = d + 1;
+			carry_len = c->in + c->in_len - carry;
+			c->in_len -= carry_len;
+		}
+
+		if (!c->in_len)
+			break;
+
+		pthread_mutex_lock(&pl->lock);
+		c->state = CHUNK_READ;
+		++pl->read;
+		pthread_cond_broadcast(&pl->cond);
+		pthread_mutex_unlock(&pl->lock);
+	}
+
+	return 0;
+}
+
+/**
+ * pad_pipeline() - Pad every record read from a file descriptor, in parallel
+ *
+ * @fd: The file descriptor to read from
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @padding_char: Padding character
+ * @delim: Record separator
+ * @jobs: Number of worker threads
+ *
+ * Produces the same output as pad_stream(), but with one thread reading the
+ * input in chunks of STREAM_BLOCK bytes, cut at record boundaries, @jobs
+ * threads padding whole chunks into their own output buffers at once and one
+ * thread writing those in the order they were read in. There are
+ * PIPELINE_DEPTH chunks per worker in flight, so reading, padding and
+ * writing overlap, while memory use does not grow with the input. Chunks
+ * get their buffers only once the reader gets to them and threads a small
+ * stack of PIPELINE_STACK bytes, so neither does it grow much with @jobs for
+ * a short input.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_pipeline(int fd, int mode, size_t size, char *padding_char,
+		 char delim, int jobs)
+{
+	struct pipeline pl = {
+		.nchunks = (size_t)jobs * PIPELINE_DEPTH,
+		.mode = mode,
+		.size = size,
+		.delim = delim,
+	};
+	pthread_t *threads = calloc(jobs + 1, sizeof(pthread_t));
+	pthread_attr_t attr;
+	int started = 0;
+	int ret = 1;
+
+	pl.chunks = calloc(pl.nchunks, sizeof(struct chunk));
+
+	if (!threads || !pl.chunks || fill_init(&pl.fill, padding_char, size)) {
+		perror("pad - pipeline");
+		goto out;
+	}
+
+	pthread_mutex_init(&pl.lock, NULL);
+	pthread_cond_init(&pl.cond, NULL);
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, PIPELINE_STACK);
+
+	for (; started <= jobs; ++started) {
+		int err = pthread_create(&threads[started], &attr,
+					 started ? worker : writer, &pl);
+
+		if (err) {
+			errno = err;
+			perror("pad - pipeline");
+			pipeline_fail(&pl);
+			break;
+		}
+	}
+
+	if (!pl.err && reader(&pl, fd))
+		pipeline_fail(&pl);
+
+	pthread_mutex_lock(&pl.lock);
+	pl.eof = 1;
+	pthread_cond_broadcast(&pl.cond);
+	pthread_mutex_unlock(&pl.lock);
+
+	while (started)
+		pthread_join(threads[--started], NULL);
+
+	ret = pl.err;
+
+	pthread_attr_destroy(&attr);
+	pthread_cond_destroy(&pl.cond);
+	pthread_mutex_destroy(&pl.lock);
+out:
+	for (size_t i = 0; pl.chunks && i < pl.nchunks; ++i) {
+		free(pl.chunks[i].in);
+		strbuf_release(&pl.chunks[i].out);
+	}
+
+	free(pl.chunks);
+	free(threads);
+	fill_free(&pl.fill);
+	return ret;
+}
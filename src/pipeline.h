@@ -0,0 +1,17 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <stddef.h>
+
+// Number of chunks in flight per worker thread
+#define PIPELINE_DEPTH 2
+// Stack of each thread, they only need room for an emitter
+#define PIPELINE_STACK (256 << 10)
+
+// input fd, mode, size of result, padding, record separator, worker threads
+int pad_pipeline(int, int, size_t, char *, char, int);
+
+#endif
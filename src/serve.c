@@ -0,0 +1,447 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "padding.h"
+#include "serve.h"
+
+/**
+ * struct server - Buffers kept from one request to the next
+ *
+ * @in: Requests read, but not answered yet
+ * @in_size: Size of @in
+ * @in_len: Number of bytes in @in
+ * @in_pos: Offset of the next request in @in
+ * @out: Responses not written yet
+ * @out_size: Size of @out
+ * @out_len: Number of bytes in @out
+ */
+struct server {
+	char *in;
+	size_t in_size;
+	size_t in_len;
+	size_t in_pos;
+	char *out;
+	size_t out_size;
+	size_t out_len;
+};
+
+static uint32_t get_u32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+	       (uint32_t)p[3] << 24;
+}
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+/**
+ * serve_grow() - Make sure a buffer is large enough
+ *
+ * @buf: The buffer
+ * @size: Its size
+ * @need: Number of bytes it has to hold
+ *
+ * Buffers only ever grow, so a connection with requests of about the same
+ * size stops allocating after the first one.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure
+ */
+static int serve_grow(char **buf, size_t *size, size_t need)
+{
+	if (need <= *size)
+		return 0;
+
+	size_t new_size = *size ? *size : 256;
+
+	while (new_size < need)
+		new_size *= 2;
+
+	char *tmp = realloc(*buf, new_size);
+
+	if (!tmp) {
+		perror("pad - serve");
+		return 1;
+	}
+
+	*buf = tmp;
+	*size = new_size;
+	return 0;
+}
+
+/**
+ * serve_fill() - Read more requests
+ *
+ * @sv: The server
+ * @fd: The file descriptor to read from
+ * @sock: Whether @fd is a socket
+ * @need: Number of bytes the next request takes up, as far as we know
+ *
+ * Whatever is left of @sv->in is moved to its front, @sv->in is grown to hold
+ * at least @need bytes and then filled with as much as a single read gets us.
+ * Sockets are read with recv(), so with --socket the seccomp filter does not
+ * allow read() on anything but stdin.
+ *
+ * Returns:
+ * * Number of bytes read, 0 at the end of the input
+ * * -1 on any error
+ */
+static ssize_t serve_fill(struct server *sv, int fd, int sock, size_t need)
+{
+	sv->in_len -= sv->in_pos;
+	memmove(sv->in, sv->in + sv->in_pos, sv->in_len);
+	sv->in_pos = 0;
+
+	if (serve_grow(&sv->in, &sv->in_size, need))
+		return -1;
+
+	for (;;) {
+		ssize_t n = sock ? recv(fd, sv->in + sv->in_len,
+					sv->in_size - sv->in_len, 0) :
+				   read(fd, sv->in + sv->in_len,
+					sv->in_size - sv->in_len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("pad - serve");
+			return -1;
+		}
+
+		sv->in_len += n;
+		return n;
+	}
+}
+
+/**
+ * serve_write() - Write a number of bytes
+ *
+ * @fd: The file descriptor to write to
+ * @sock: Whether @fd is a socket
+ * @buf: The bytes
+ * @len: Number of bytes in @buf
+ *
+ * Like serve_fill(), sockets are written with send(). A client that went
+ * away does not raise SIGPIPE, it just ends the connection.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int serve_write(int fd, int sock, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = sock ? send(fd, buf, len, MSG_NOSIGNAL) :
+				   write(fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("pad - serve");
+			return 1;
+		}
+
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * serve_respond() - Add a response to the output
+ *
+ * @sv: The server
+ * @status: SERVE_OK or an error
+ * @mode: Requested mode
+ * @size: Requested size
+ * @c: The padding character, NUL-terminated
+ * @s: The string
+ * @len: Length of @s in bytes
+ *
+ * The string is padded into @sv->out right behind the header of its
+ * response. If it does not fit, @sv->out is grown to what pad_buf() asks for
+ * and it is padded again.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure
+ */
+static int serve_respond(struct server *sv, uint32_t status, int mode,
+			 size_t size, char *c, const char *s, size_t len)
+{
+	size_t n = 0;
+
+	if (serve_grow(&sv->out, &sv->out_size, sv->out_len + SERVE_RESPONSE))
+		return 1;
+
+	char *dst = sv->out + sv->out_len + SERVE_RESPONSE;
+	size_t room = sv->out_size - sv->out_len - SERVE_RESPONSE;
+
+	if (status == SERVE_OK)
+		n = pad_buf(dst, room, mode, s, len, size, c);
+
+	if (n > SERVE_MAX) {
+		status = SERVE_E2BIG;
+		n = 0;
+	} else if (n > room) {
+		if (serve_grow(&sv->out, &sv->out_size,
+			       sv->out_len + SERVE_RESPONSE + n))
+			return 1;
+
+		dst = sv->out + sv->out_len + SERVE_RESPONSE;
+		pad_buf(dst, n, mode, s, len, size, c);
+	}
+
+	put_u32((unsigned char *)sv->out + sv->out_len, n);
+	put_u32((unsigned char *)sv->out + sv->out_len + 4, status);
+	sv->out_len += SERVE_RESPONSE + n;
+
+	return 0;
+}
+
+/**
+ * serve_flush() - Write out all responses
+ *
+ * @sv: The server
+ * @fd: The file descriptor to write to
+ * @sock: Whether @fd is a socket
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int serve_flush(struct server *sv, int fd, int sock)
+{
+	int ret = serve_write(fd, sock, sv->out, sv->out_len);
+
+	sv->out_len = 0;
+	return ret;
+}
+
+/**
+ * serve_conn() - Answer requests until the input ends
+ *
+ * @sv: The server
+ * @in: Where the requests come from
+ * @out: Where the responses go
+ * @sock: Whether @in and @out are a socket
+ *
+ * We answer every complete request in @sv->in and only write the responses
+ * once we have to wait for more, so a client that sends several requests at
+ * once gets their responses with a single write, too. A request we cannot
+ * answer gets an error status. A string larger than SERVE_MAX ends the
+ * connection after that, since we would have to read it anyway to get to the
+ * next request.
+ *
+ * Returns:
+ * * 0 at the end of the input
+ * * 1 on any error
+ */
+static int serve_conn(struct server *sv, int in, int out, int sock)
+{
+	sv->in_len = sv->in_pos = sv->out_len = 0;
+
+	for (;;) {
+		const unsigned char *h =
+			(const unsigned char *)sv->in + sv->in_pos;
+		size_t avail = sv->in_len - sv->in_pos;
+		size_t need = SERVE_REQUEST;
+
+		if (avail >= SERVE_REQUEST) {
+			if (get_u32(h) > SERVE_MAX) {
+				if (serve_respond(sv, SERVE_E2BIG, 0, 0, NULL,
+						  NULL, 0))
+					return 1;
+
+				return serve_flush(sv, out, sock);
+			}
+
+			need += h[9] + get_u32(h);
+		}
+
+		if (avail < need) {
+			if (serve_flush(sv, out, sock))
+				return 1;
+
+			ssize_t n = serve_fill(sv, in, sock, need);
+
+			if (n <= 0)
+				return n < 0;
+
+			continue;
+		}
+
+		size_t len = get_u32(h);
+		size_t size = get_u32(h + 4);
+		int mode = h[8];
+		size_t clen = h[9];
+		const char *s = (const char *)h + SERVE_REQUEST + clen;
+		char c[CHAR_WIDTH] = " ";
+		uint32_t status = SERVE_OK;
+
+		// The reserved field may carry flags one day, which we would
+		// not know how to honour
+		// A padding character starting with a NUL byte is empty, like
+		// -c "" is
+		if ((mode & ~(MODE_MASK | MODE_FLAGS)) || clen >= CHAR_WIDTH ||
+		    (clen && !h[SERVE_REQUEST]) || (h[10] | h[11])) {
+			status = SERVE_EINVAL;
+		} else if (clen) {
+			memcpy(c, h + SERVE_REQUEST, clen);
+			c[clen] = '\0';
+		}
+
+		if (serve_respond(sv, status, mode, size, c, s, len))
+			return 1;
+
+		sv->in_pos += need;
+
+		// Do not collect more than a buffer full of responses
+		if (sv->out_len >= SERVE_BUF && serve_flush(sv, out, sock))
+			return 1;
+	}
+}
+
+/**
+ * serve_stale() - Remove a socket an earlier server left behind
+ *
+ * @addr: Address of the socket
+ *
+ * The file of a Unix socket outlives the server, so binding to its path a
+ * second time fails with EADDRINUSE. Only a socket nobody accepts connections
+ * on any more is removed, anything else at the path is left to bind() to
+ * complain about.
+ *
+ * Returns:
+ * * 0 if there is nothing in the way of bind() we could remove
+ * * -1 on any error
+ */
+static int serve_stale(const struct sockaddr_un *addr)
+{
+	struct stat st;
+
+	if (lstat(addr->sun_path, &st) || !S_ISSOCK(st.st_mode))
+		return 0;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return -1;
+
+	int live = !connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+	int stale = !live && errno == ECONNREFUSED;
+
+	close(fd);
+
+	if (stale && unlink(addr->sun_path) && errno != ENOENT)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * serve_listen() - Create a listening Unix socket
+ *
+ * @path: Path of the socket
+ *
+ * A socket left behind at @path by an earlier server is replaced, see
+ * serve_stale(). This has to happen before the seccomp filter is in place,
+ * which allows neither unlink() nor bind().
+ *
+ * Returns:
+ * * The socket
+ * * -1 on any error
+ */
+int serve_listen(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "pad - serve: Socket path too long\n");
+		return -1;
+	}
+
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		perror("pad - serve");
+		return -1;
+	}
+
+	if (serve_stale(&addr) ||
+	    bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(fd, 16)) {
+		perror("pad - serve");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * pad_serve() - Answer framed requests, see serve.h
+ *
+ * @sock: Socket from serve_listen(), or -1 to answer requests from stdin on
+ * stdout, e.g. as a coproc of a shell
+ *
+ * Connections to @sock are served one after the other, each until the client
+ * closes it. The buffers are shared by all of them.
+ *
+ * Returns:
+ * * 0 at the end of stdin
+ * * 1 on any error
+ */
+int pad_serve(int sock)
+{
+	struct server sv = { 0 };
+	int ret = 1;
+
+	if (serve_grow(&sv.in, &sv.in_size, SERVE_BUF))
+		goto out;
+
+	if (sock < 0) {
+		ret = serve_conn(&sv, STDIN_FILENO, STDOUT_FILENO, 0);
+		goto out;
+	}
+
+	for (;;) {
+		int fd = accept(sock, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			perror("pad - serve");
+			break;
+		}
+
+		serve_conn(&sv, fd, fd, 1);
+		close(fd);
+	}
+out:
+	free(sv.in);
+	free(sv.out);
+	return ret;
+}
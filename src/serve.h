@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SERVE_H
+#define SERVE_H
+
+// A request is a header of SERVE_REQUEST bytes, followed by the padding
+// character and the string to pad. All integers are little endian:
+//
+//	u32 length of the string in bytes
+//	u32 size of the padded string (left offset for MODE_CENTRE)
+//	u8  MODE_LEFT, MODE_RIGHT, MODE_BOTH or MODE_CENTRE, | MODE_TRUNCATE to
+//	    cut longer strings, and | MODE_ELLIPSIS to end them with ELLIPSIS,
+//	    | MODE_COLUMNS to
+//	    measure the string in terminal columns, | MODE_ANSI to skip ANSI
+//	    escape sequences when measuring it, | MODE_GRAPHEMES to count
+//	    grapheme clusters
+//	u8  length of the padding character in bytes, 0 for a space
+//	u16 reserved, 0
+//
+// Every request is answered with a header of SERVE_RESPONSE bytes, followed
+// by the padded string:
+//
+//	u32 length of the padded string in bytes
+//	u32 SERVE_OK or one of the errors below
+#define SERVE_REQUEST 12
+#define SERVE_RESPONSE 8
+
+#define SERVE_OK 0
+// Unknown mode, a padding character longer than CHAR_WIDTH - 1 bytes or
+// starting with a NUL byte, or a reserved field that is not 0
+#define SERVE_EINVAL 1
+// The string or the padded string is larger than SERVE_MAX
+#define SERVE_E2BIG 2
+
+// Largest string and padded string we handle, in bytes
+#define SERVE_MAX (64 << 20)
+
+// Size of the buffers requests are read into and responses collected in
+#define SERVE_BUF (64 << 10)
+
+// path of the socket
+int serve_listen(const char *);
+// listening socket, or -1 for stdin and stdout
+int pad_serve(int);
+
+#endif
@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// The kernels of simd-kernels.c, built for AVX2
+#if defined(__x86_64__)
+#pragma GCC target("avx2")
+#define SIMD_ISA avx2
+#include "simd-kernels.c"
+#else
+// ISO C does not allow an empty translation unit
+typedef int simd_avx2_unused;
+#endif
@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// The kernels of simd-kernels.c, built for AVX-512BW
+#if defined(__x86_64__)
+#pragma GCC target("avx512f,avx512bw")
+#define SIMD_ISA avx512
+#include "simd-kernels.c"
+#else
+// ISO C does not allow an empty translation unit
+typedef int simd_avx512_unused;
+#endif
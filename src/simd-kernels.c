@@ -0,0 +1,270 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// The vector kernels behind simd.h. This file is built once as it is, for the
+// baseline of the target (SSE2 on x86-64, plain C elsewhere), and once more
+// for every instruction set simd.c can pick at runtime: simd-avx2.c and
+// simd-avx512.c set a target pragma and SIMD_ISA and then include this file.
+// Every kernel gets SIMD_ISA appended to its name.
+
+#ifndef SIMD_ISA
+#define SIMD_ISA generic
+#endif
+
+#include <string.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "simd-kernels.h"
+
+#define SIMD_CONCAT(name, isa) name##_##isa
+#define SIMD_NAME(name, isa) SIMD_CONCAT(name, isa)
+#define SIMD(name) SIMD_NAME(name, SIMD_ISA)
+
+// Bytes per vector and the few operations the kernels need
+#if defined(__AVX512BW__)
+#define VEC 64
+typedef __m512i vec;
+#define vload(p) _mm512_loadu_si512((const void *)(p))
+#define vstore(p, v) _mm512_storeu_si512((void *)(p), v)
+#define vset1(c) _mm512_set1_epi8(c)
+#define veq(a, b) ((unsigned long long)_mm512_cmpeq_epi8_mask(a, b))
+#elif defined(__AVX2__)
+#define VEC 32
+typedef __m256i vec;
+#define vload(p) _mm256_loadu_si256((const __m256i *)(p))
+#define vstore(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define vset1(c) _mm256_set1_epi8(c)
+#define veq(a, b) \
+	((unsigned long long)(unsigned int)_mm256_movemask_epi8( \
+		_mm256_cmpeq_epi8(a, b)))
+#elif defined(__SSE2__)
+#define VEC 16
+typedef __m128i vec;
+#define vload(p) _mm_loadu_si128((const __m128i *)(p))
+#define vstore(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define vset1(c) _mm_set1_epi8(c)
+#define veq(a, b) \
+	((unsigned long long)(unsigned int)_mm_movemask_epi8( \
+		_mm_cmpeq_epi8(a, b)))
+#endif
+
+/**
+ * simd_find_byte() - Find the first occurrence of a byte
+ *
+ * @s: The bytes to search
+ * @len: Number of bytes in @s
+ * @c: The byte to look for
+ *
+ * Compare a whole vector of @s with @c at a time and take the position of the
+ * first match from the mask of the comparison. Whatever is left at the end of
+ * @s is searched byte by byte. Unlike strchr() this does not stop at NUL
+ * bytes, so it can look for them, too.
+ *
+ * Returns:
+ * * Pointer to the first @c in @s
+ * * NULL, if @s does not contain @c
+ */
+const char *SIMD(simd_find_byte)(const char *s, size_t len, char c)
+{
+#ifdef VEC
+	const vec needle = vset1(c);
+
+	for (; len >= VEC; s += VEC, len -= VEC) {
+		unsigned long long mask = veq(vload(s), needle);
+
+		if (mask)
+			return s + __builtin_ctzll(mask);
+	}
+#endif
+	for (; len; ++s, --len)
+		if (*s == c)
+			return s;
+
+	return NULL;
+}
+
+/**
+ * simd_rfind_byte() - Find the last occurrence of a byte
+ *
+ * @s: The bytes to search
+ * @len: Number of bytes in @s
+ * @c: The byte to look for
+ *
+ * Like simd_find_byte(), but a vector at a time from the end of @s, taking
+ * the position of the last match from the highest bit of the mask. Whatever
+ * is left at the start of @s is searched byte by byte.
+ *
+ * Returns:
+ * * Pointer to the last @c in @s
+ * * NULL, if @s does not contain @c
+ */
+const char *SIMD(simd_rfind_byte)(const char *s, size_t len, char c)
+{
+#ifdef VEC
+	const vec needle = vset1(c);
+
+	for (; len >= VEC; len -= VEC) {
+		unsigned long long mask = veq(vload(s + len - VEC), needle);
+
+		if (mask)
+			return s + len - VEC + 63 - __builtin_clzll(mask);
+	}
+#endif
+	while (len--)
+		if (s[len] == c)
+			return s + len;
+
+	return NULL;
+}
+
+/**
+ * fill_double() - Fill a buffer with a pattern by doubling
+ *
+ * @dst: The buffer
+ * @len: Number of bytes to fill
+ * @pat: The pattern
+ * @patlen: Length of @pat
+ *
+ * Copy @pat once, then keep copying everything that is already filled in
+ * behind itself, so it only takes log2(@len / @patlen) calls to memcpy().
+ */
+static void fill_double(char *dst, size_t len, const char *pat, size_t patlen)
+{
+	size_t done = (patlen < len) ? patlen : len;
+
+	memcpy(dst, pat, done);
+	for (; done < len; done *= 2)
+		memcpy(dst + done, dst, (len - done < done) ? len - done : done);
+}
+
+/**
+ * simd_fill() - Fill a buffer with a repeated pattern
+ *
+ * @dst: The buffer
+ * @len: Number of bytes to fill
+ * @pat: The pattern, e.g. an encoded UTF-8 character
+ * @patlen: Length of @pat
+ *
+ * A vector can only be stored over and over again if its length is a
+ * multiple of the pattern length, which does not work out for 3-byte UTF-8
+ * characters. Three vectors do for every pattern of 1 to 4 bytes, though, so
+ * we lay @pat out over three 32-bit words (12 bytes, again a multiple of 1 to
+ * 4), repeat those over a period of three vectors, load the three
+ * period-aligned vectors and store all three of them per iteration. Whatever
+ * is left at the end is copied from the period, which starts with the same
+ * phase of @pat. Longer patterns, and CPUs without vectors, fall back to
+ * fill_double().
+ */
+void SIMD(simd_fill)(char *dst, size_t len, const char *pat, size_t patlen)
+{
+	if (!len || !patlen)
+		return;
+
+#ifdef VEC
+	if (patlen <= 4) {
+		char period[3 * VEC];
+		char words[12];
+
+		for (size_t i = 0, j = 0; i < sizeof(words); ++i) {
+			words[i] = pat[j];
+			if (++j == patlen)
+				j = 0;
+		}
+
+		for (size_t i = 0; i < sizeof(period); i += sizeof(words))
+			memcpy(period + i, words, sizeof(words));
+
+		vec v0 = vload(period);
+		vec v1 = vload(period + VEC);
+		vec v2 = vload(period + 2 * VEC);
+
+		for (; len >= sizeof(period); len -= sizeof(period)) {
+			vstore(dst, v0);
+			vstore(dst + VEC, v1);
+			vstore(dst + 2 * VEC, v2);
+			dst += sizeof(period);
+		}
+
+		memcpy(dst, period, len);
+		return;
+	}
+#endif
+	fill_double(dst, len, pat, patlen);
+}
+
+/**
+ * simd_utf8_count() - Count the UTF-8 characters in a string
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ *
+ * Every UTF-8 character has exactly one byte that is not a continuation byte
+ * (10xxxxxx), i.e. one byte that is at least -64 when read as a signed char.
+ * So instead of walking @s character by character, we compare a whole vector
+ * of bytes against that. AVX-512 gives us the result as a bit mask we can
+ * popcount. Otherwise we subtract the resulting 0/-1 bytes from per-byte
+ * counters, which are summed up with psadbw before they can overflow, i.e.
+ * every 255 vectors. The tail is counted byte by byte. Unlike utf8_strlen()
+ * this does not stop at NUL bytes.
+ *
+ * Returns: Number of characters in @s
+ */
+size_t SIMD(simd_utf8_count)(const char *s, size_t len)
+{
+	size_t count = 0;
+
+#if defined(__AVX512BW__)
+	const vec cont = vset1(-65);
+
+	for (; len >= VEC; s += VEC, len -= VEC)
+		count += __builtin_popcountll(
+			_mm512_cmpgt_epi8_mask(vload(s), cont));
+#elif defined(__AVX2__)
+	const vec cont = vset1(-65);
+	const vec zero = _mm256_setzero_si256();
+
+	while (len >= VEC) {
+		size_t n = len / VEC;
+		vec acc = zero;
+
+		if (n > 255)
+			n = 255;
+
+		for (size_t i = 0; i < n; ++i, s += VEC)
+			acc = _mm256_sub_epi8(acc,
+					      _mm256_cmpgt_epi8(vload(s), cont));
+
+		acc = _mm256_sad_epu8(acc, zero);
+		count += _mm256_extract_epi64(acc, 0) +
+			 _mm256_extract_epi64(acc, 1) +
+			 _mm256_extract_epi64(acc, 2) +
+			 _mm256_extract_epi64(acc, 3);
+		len -= n * VEC;
+	}
+#elif defined(__SSE2__)
+	const vec cont = vset1(-65);
+	const vec zero = _mm_setzero_si128();
+
+	while (len >= VEC) {
+		size_t n = len / VEC;
+		vec acc = zero;
+
+		if (n > 255)
+			n = 255;
+
+		for (size_t i = 0; i < n; ++i, s += VEC)
+			acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(vload(s), cont));
+
+		acc = _mm_sad_epu8(acc, zero);
+		count += _mm_cvtsi128_si64(acc) +
+			 _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+		len -= n * VEC;
+	}
+#endif
+	for (; len; ++s, --len)
+		count += ((signed char)*s >= -64);
+
+	return count;
+}
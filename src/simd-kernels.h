@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+#include <stddef.h>
+
+// Declare the kernels built for one instruction set, see simd-kernels.c
+#define SIMD_KERNELS(isa)                                                     \
+	const char *simd_find_byte_##isa(const char *, size_t, char);         \
+	const char *simd_rfind_byte_##isa(const char *, size_t, char);        \
+	void simd_fill_##isa(char *, size_t, const char *, size_t);           \
+	size_t simd_utf8_count_##isa(const char *, size_t);
+
+SIMD_KERNELS(generic)
+#if defined(__x86_64__)
+SIMD_KERNELS(avx2)
+SIMD_KERNELS(avx512)
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdlib.h>
+#include <string.h>
+#include "simd-kernels.h"
+#include "simd.h"
+
+// Fewer characters than this are left to simd_utf8_prefix() byte by byte
+#define SIMD_PREFIX_MIN 16
+
+/**
+ * struct simd_ops - The kernels of one instruction set
+ *
+ * @name: Name of the instruction set
+ * @find_byte: See simd_find_byte()
+ * @rfind_byte: See simd_rfind_byte()
+ * @fill: See simd_fill()
+ * @utf8_count: See simd_utf8_count()
+ */
+struct simd_ops {
+	const char *name;
+	const char *(*find_byte)(const char *, size_t, char);
+	const char *(*rfind_byte)(const char *, size_t, char);
+	void (*fill)(char *, size_t, const char *, size_t);
+	size_t (*utf8_count)(const char *, size_t);
+};
+
+#define SIMD_OPS(isa)                                                \
+	{                                                            \
+		#isa, simd_find_byte_##isa, simd_rfind_byte_##isa,   \
+			simd_fill_##isa, simd_utf8_count_##isa       \
+	}
+
+// Best first
+static const struct simd_ops simd_table[] = {
+#if defined(__x86_64__)
+	SIMD_OPS(avx512),
+	SIMD_OPS(avx2),
+#endif
+	SIMD_OPS(generic),
+};
+
+#define SIMD_TABLE_SIZE (sizeof(simd_table) / sizeof(simd_table[0]))
+
+static const struct simd_ops *simd = &simd_table[SIMD_TABLE_SIZE - 1];
+
+/**
+ * simd_supported() - Check if the CPU can run a set of kernels
+ *
+ * @ops: The kernels
+ *
+ * Returns:
+ * * 1, if the CPU supports the instruction set of @ops
+ * * 0, if not
+ */
+static int simd_supported(const struct simd_ops *ops)
+{
+#if defined(__x86_64__)
+	if (!strcmp(ops->name, "avx512"))
+		return __builtin_cpu_supports("avx512f") &&
+		       __builtin_cpu_supports("avx512bw");
+	if (!strcmp(ops->name, "avx2"))
+		return __builtin_cpu_supports("avx2");
+#endif
+	return !strcmp(ops->name, "generic");
+}
+
+/**
+ * simd_select() - Pick the kernels for this CPU
+ *
+ * Runs once at startup, before main(). We take the first entry of simd_table
+ * the CPU supports, so one binary runs the best kernels it can everywhere,
+ * instead of being built for the CPU of the build host. PAD_SIMD can be set
+ * to the name of an entry to take that one instead, as long as the CPU
+ * supports it, e.g. to compare them.
+ */
+__attribute__((constructor)) static void simd_select(void)
+{
+	const char *want = getenv("PAD_SIMD");
+
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+#endif
+
+	for (size_t i = 0; i < SIMD_TABLE_SIZE; ++i) {
+		if (want && strcmp(want, simd_table[i].name))
+			continue;
+
+		if (simd_supported(&simd_table[i])) {
+			simd = &simd_table[i];
+			return;
+		}
+	}
+}
+
+/**
+ * simd_name() - Name of the kernels in use
+ *
+ * Returns: "avx512", "avx2" or "generic"
+ */
+const char *simd_name(void)
+{
+	return simd->name;
+}
+
+/**
+ * simd_find_byte() - Find the first occurrence of a byte
+ *
+ * @s: The bytes to search
+ * @len: Number of bytes in @s
+ * @c: The byte to look for
+ *
+ * Unlike strchr() this does not stop at NUL bytes, so it can look for them,
+ * too.
+ *
+ * Returns:
+ * * Pointer to the first @c in @s
+ * * NULL, if @s does not contain @c
+ */
+const char *simd_find_byte(const char *s, size_t len, char c)
+{
+	return simd->find_byte(s, len, c);
+}
+
+/**
+ * simd_rfind_byte() - Find the last occurrence of a byte
+ *
+ * @s: The bytes to search
+ * @len: Number of bytes in @s
+ * @c: The byte to look for
+ *
+ * Like simd_find_byte(), but from the end of @s.
+ *
+ * Returns:
+ * * Pointer to the last @c in @s
+ * * NULL, if @s does not contain @c
+ */
+const char *simd_rfind_byte(const char *s, size_t len, char c)
+{
+	return simd->rfind_byte(s, len, c);
+}
+
+/**
+ * simd_fill() - Fill a buffer with a repeated pattern
+ *
+ * @dst: The buffer
+ * @len: Number of bytes to fill
+ * @pat: The pattern, e.g. an encoded UTF-8 character
+ * @patlen: Length of @pat
+ */
+void simd_fill(char *dst, size_t len, const char *pat, size_t patlen)
+{
+	simd->fill(dst, len, pat, patlen);
+}
+
+/**
+ * simd_utf8_count() - Count the UTF-8 characters in a string
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ *
+ * Counts the bytes that are not continuation bytes. Unlike utf8_strlen() this
+ * does not stop at NUL bytes.
+ *
+ * Returns: Number of characters in @s
+ */
+size_t simd_utf8_count(const char *s, size_t len)
+{
+	return simd->utf8_count(s, len);
+}
+
+/**
+ * simd_utf8_prefix() - Longest start of a string within some characters
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ * @max: Number of characters the start may have
+ * @count: Set to the number of characters it has
+ *
+ * Every character takes at least one byte, so the next @max bytes never hold
+ * more than @max characters. We count them with simd_utf8_count() and go on
+ * with whatever is left of @max, until that is too little for the kernel to
+ * pay off and the rest is counted byte by byte. This goes through @s once,
+ * front to back, and only as far as the start reaches. The cut falls in
+ * front of a byte that is not a continuation byte, i.e. between two
+ * characters.
+ *
+ * Returns: Length of the start in bytes, @len if all of @s fits
+ */
+size_t simd_utf8_prefix(const char *s, size_t len, size_t max, size_t *count)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i < len && max - n >= SIMD_PREFIX_MIN) {
+		size_t chunk = (len - i < max - n) ? len - i : max - n;
+
+		n += simd->utf8_count(s + i, chunk);
+		i += chunk;
+	}
+
+	for (; i < len; ++i) {
+		if ((s[i] & 0xc0) == 0x80)
+			continue;
+		if (n == max)
+			break;
+		++n;
+	}
+
+	*count = n;
+	return i;
+}
@@ -0,0 +1,20 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SIMD_H
+#define SIMD_H
+#include <stddef.h>
+
+// haystack, length of haystack, needle
+const char *simd_find_byte(const char *, size_t, char);
+const char *simd_rfind_byte(const char *, size_t, char);
+// destination, number of bytes, pattern, length of pattern
+void simd_fill(char *, size_t, const char *, size_t);
+// string, length of string in bytes
+size_t simd_utf8_count(const char *, size_t);
+// string, length of string in bytes, characters, set to the characters taken
+size_t simd_utf8_prefix(const char *, size_t, size_t, size_t *);
+const char *simd_name(void);
+
+#endif
@@ -1,43 +1,450 @@
 // SPDX-FileCopyrightText: 2023 zocker <zocker@10zen.eu>
 // SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include "simd.h"
 #include "strbuf.h"
 
 /**
- * strbuf_cat() - Concatenate a string onto a strbuf-managed string
+ * strview_bytes() - View some bytes
+ *
+ * @data: The bytes, they may contain NUL bytes
+ * @len: Number of bytes in @data
+ *
+ * Returns: A view of @data, with its characters not counted yet
+ */
+struct strview strview_bytes(const char *data, size_t len)
+{
+	return (struct strview){ data, len, STRVIEW_UNKNOWN };
+}
+
+/**
+ * strview_str() - View a cstring
+ *
+ * @s: The cstring
+ *
+ * This is the one place the length of @s is looked for, everything that is
+ * handed the view takes it from there.
+ *
+ * Returns: A view of @s, without its final NUL byte
+ */
+struct strview strview_str(const char *s)
+{
+	return strview_bytes(s, strlen(s));
+}
+
+/**
+ * strbuf_alloc() - Initialise a strbuf that grows
+ *
+ * @s: Local strbuf struct
+ * @size: Number of bytes to start with, STRBUF_MIN if less
+ *
+ * Unlike strbuf_init() the buffer is our own, and anything appended to @s
+ * makes room for itself with strbuf_reserve() instead of marking @s as
+ * overflowed. Clearing @s keeps the buffer, so a strbuf that is reused for
+ * one record after the other stops allocating once it got as large as the
+ * largest of them.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure, with errno set
+ */
+int strbuf_alloc(struct strbuf *s, size_t size)
+{
+	if (size < STRBUF_MIN)
+		size = STRBUF_MIN;
+
+	char *data = malloc(size);
+
+	if (!data)
+		return 1;
+
+	strbuf_init(s, data, size);
+	s->kind = STRBUF_GROW;
+	return 0;
+}
+
+/**
+ * strbuf_init_stack() - Initialise a strbuf that grows, starting on the stack
+ *
+ * @s: Local strbuf struct
+ * @data: A buffer of the caller, e.g. on the stack
+ * @size: Size of @data
+ *
+ * Like strbuf_alloc(), but as long as everything fits into @data, nothing is
+ * allocated. Only once it does not, @s moves to the heap and is a strbuf
+ * from strbuf_alloc() from then on, to be released with strbuf_release(),
+ * which does nothing as long as it has not moved.
+ */
+void strbuf_init_stack(struct strbuf *s, char *data, size_t size)
+{
+	strbuf_init(s, data, size);
+	s->kind = STRBUF_STACK;
+}
+
+/**
+ * strbuf_open() - Initialise a strbuf that flushes to a file descriptor
+ *
+ * @s: Local strbuf struct
+ * @fd: The file descriptor
+ * @size: Number of bytes to collect before they are written, STRBUF_FLUSH if
+ * 0, STRBUF_MIN if less
+ *
+ * Anything appended to @s that does not fit any more writes out what @s
+ * holds first, see strbuf_reserve(), so no matter how much goes through @s,
+ * it takes @size bytes, or as many as the largest padded string. Appending
+ * more than @size bytes at once writes them straight to @fd. Whatever is
+ * still in @s at the end has to be written with strbuf_flush().
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure, with errno set
+ */
+int strbuf_open(struct strbuf *s, int fd, size_t size)
+{
+	if (!size)
+		size = STRBUF_FLUSH;
+
+	if (strbuf_alloc(s, size))
+		return 1;
+
+	s->kind = STRBUF_FD;
+	s->fd = fd;
+	return 0;
+}
+
+/**
+ * strbuf_arena() - Initialise a strbuf that grows within an arena
+ *
+ * @s: Local strbuf struct
+ * @a: The arena
+ * @size: Number of bytes to start with, STRBUF_MIN if less
+ *
+ * Like strbuf_alloc(), but all memory comes from @a, so a scratch strbuf for
+ * every record costs no more than moving through @a. Growing leaves the old
+ * buffer behind in @a. @s must not be used after @a was reset, and is never
+ * released on its own.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on allocation failure, with errno set
+ */
+int strbuf_arena(struct strbuf *s, struct arena *a, size_t size)
+{
+	if (size < STRBUF_MIN)
+		size = STRBUF_MIN;
+
+	char *data = arena_alloc(a, size);
+
+	if (!data)
+		return 1;
+
+	strbuf_init(s, data, size);
+	s->kind = STRBUF_ARENA;
+	s->arena = a;
+	return 0;
+}
+
+/**
+ * strbuf_retry() - Check if a failed write is worth trying again
+ *
+ * @fd: The file descriptor the write failed on, with errno set
+ *
+ * A write interrupted by a signal is. So is one to a non-blocking @fd that
+ * is full, e.g. a pipe nobody reads fast enough, once poll() says there is
+ * room again.
+ *
+ * Returns:
+ * * 1 if it is
+ * * 0 if not, with errno set
+ */
+int strbuf_retry(int fd)
+{
+	struct pollfd p = { .fd = fd, .events = POLLOUT };
+
+	if (errno == EINTR)
+		return 1;
+
+	return (errno == EAGAIN || errno == EWOULDBLOCK) &&
+	       (poll(&p, 1, -1) >= 0 || errno == EINTR);
+}
+
+/**
+ * fd_write() - Write a number of bytes
+ *
+ * @fd: The file descriptor to write to
+ * @b: The bytes
+ * @len: Number of bytes in @b
+ *
+ * write() may write less than we asked for, so we skip over whatever was
+ * written and try again with the rest, and after errors strbuf_retry() says
+ * are worth it.
+ *
+ * Returns: Number of bytes written, less than @len on any error, with errno
+ * set
+ */
+static size_t fd_write(int fd, const char *b, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = write(fd, b + done, len - done);
+
+		if (n < 0) {
+			if (strbuf_retry(fd))
+				continue;
+
+			break;
+		}
+
+		done += n;
+	}
+
+	return done;
+}
+
+/**
+ * strbuf_flush() - Write out a strbuf bound to a file descriptor
+ *
+ * @s: The managed cstring, from strbuf_open()
+ *
+ * Writes all of @s to its file descriptor and clears it. Does nothing for
+ * any other kind of strbuf. Should writing fail, @s keeps what was not
+ * written.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error, with errno set
+ */
+int strbuf_flush(struct strbuf *s)
+{
+	if (s->kind != STRBUF_FD || !s->len)
+		return 0;
+
+	size_t n = fd_write(s->fd, s->data, s->len);
+
+	s->len -= n;
+
+	if (s->len) {
+		memmove(s->data, s->data + n, s->len);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * strbuf_release() - Free the buffer of a strbuf that grows
+ *
+ * @s: The managed cstring, from strbuf_alloc() or strbuf_open()
+ *
+ * This does not flush @s, see strbuf_flush().
+ */
+void strbuf_release(struct strbuf *s)
+{
+	if (s->kind == STRBUF_GROW || s->kind == STRBUF_FD)
+		free(s->data);
+
+	s->data = NULL;
+	s->size = 0;
+	s->len = 0;
+}
+
+/**
+ * strbuf_reserve() - Make room for more bytes
  *
  * @s: The managed cstring
- * @b: The cstring to add
+ * @n: Number of bytes about to be appended
+ *
+ * A strbuf from strbuf_alloc() doubles its size until there is room for @n
+ * more bytes, plus the NUL byte strbuf_str() puts after them. One from
+ * strbuf_open() is flushed first, and only grows if @n bytes do not fit into
+ * it even then. One from strbuf_arena() moves to a larger buffer in its
+ * arena, one from strbuf_init_stack() to one on the heap. One from
+ * strbuf_init() cannot grow, so it is marked as overflowed instead, like the
+ * other functions do.
+ *
+ * Returns:
+ * * 0 if there is room for @n more bytes
+ * * 1 if not, with errno set if growing or flushing @s failed
+ */
+int strbuf_reserve(struct strbuf *s, size_t n)
+{
+	if (strbuf_has_overflowed(s))
+		return 1;
+
+	if (s->kind == STRBUF_FIXED) {
+		if (n <= strbuf_buffer_left(s))
+			return 0;
+
+		strbuf_set_overflow(s);
+		return 1;
+	}
+
+	if (n < s->size - s->len)
+		return 0;
+
+	if (s->kind == STRBUF_FD) {
+		if (strbuf_flush(s))
+			return 1;
+		if (n < s->size)
+			return 0;
+	}
+
+	if (n >= SIZE_MAX / 2 - s->len) {
+		errno = ENOMEM;
+		return 1;
+	}
+
+	size_t size = s->size ? s->size : STRBUF_MIN;
+
+	while (size <= s->len + n)
+		size *= 2;
+
+	char *data;
+
+	if (s->kind == STRBUF_ARENA) {
+		if ((data = arena_alloc(s->arena, size)))
+			memcpy(data, s->data, s->len);
+	} else if (s->kind == STRBUF_STACK) {
+		// Off to the heap, where it stays
+		if ((data = malloc(size))) {
+			memcpy(data, s->data, s->len);
+			s->kind = STRBUF_GROW;
+		}
+	} else {
+		data = realloc(s->data, size);
+	}
+
+	if (!data)
+		return 1;
+
+	s->data = data;
+	s->size = size;
+	return 0;
+}
+
+/**
+ * strbuf_append_n() - Append some bytes to a strbuf-managed string
+ *
+ * @s: The managed cstring
+ * @b: The bytes, they may contain NUL bytes
+ * @len: Number of bytes in @b
+ *
+ * A strbuf from strbuf_open() writes @b straight to its file descriptor if
+ * it is larger than the whole buffer, instead of growing.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 if @b does not fit, see strbuf_reserve()
+ */
+int strbuf_append_n(struct strbuf *s, const char *b, size_t len)
+{
+	if (s->kind == STRBUF_FD && len >= s->size)
+		return strbuf_flush(s) || fd_write(s->fd, b, len) < len;
+
+	if (strbuf_reserve(s, len))
+		return 1;
+
+	memcpy(s->data + s->len, b, len);
+	s->len += len;
+	return 0;
+}
+
+/**
+ * strbuf_fill() - Append a pattern, repeated
  *
- * First we get the size of @b with strnlen() (we care about the number of
- * bytes in @b, not the number of chars and if @b is larger than the space
- * allocated for @s , we only care that it _is_ bigger) and get a temporary
- * buffer-handle  into @s->data. If that is not possible (because @s->data
- * has overflowed), we do nothing. Else we call strncat() with the now
- * assembled arguments.
+ * @s: The managed cstring
+ * @pat: The pattern, e.g. an encoded padding character
+ * @patlen: Number of bytes in @pat
+ * @count: How often to append @pat
  *
- * Lastly we have to commit the written data, so we first check if the length
- * of @b is larger than the max_size we can use for @s->data and assing -1
- * if that is the case, so we can simplify our call to strbuf_commit() to
- * one.
+ * Writes the repetitions straight into @s with simd_fill(), without building
+ * them anywhere else first. A strbuf from strbuf_open() takes them a buffer
+ * full at a time instead of growing.
  *
- * See also: strbuf_get_buf() and strbuf_commit()
+ * Returns:
+ * * 0 on success
+ * * 1 if they do not fit, see strbuf_reserve()
  */
-void strbuf_cat(struct strbuf *s, char *b)
+int strbuf_fill(struct strbuf *s, const char *pat, size_t patlen,
+		size_t count)
 {
-	char *data = NULL;
-	size_t max_size = strbuf_get_buf(s, &data);
-	size_t b_size = strnlen(b, max_size + CHAR_WIDTH);
+	if (!patlen)
+		return 0;
 
-	if (!data || !max_size)
-		return;
+	if (s->kind != STRBUF_FD && count > SIZE_MAX / patlen) {
+		errno = ENOMEM;
+		return 1;
+	}
 
-	memccpy(data, b, '\0', max_size);
+	while (count) {
+		size_t n = count;
 
-	if (b_size > max_size)
-		b_size = -1;
+		// Leave room for the NUL byte, see strbuf_reserve()
+		if (s->kind == STRBUF_FD && n > (s->size - 1) / patlen)
+			n = (s->size - 1) / patlen;
 
-	strbuf_commit(s, b_size);
+		if (strbuf_reserve(s, n * patlen))
+			return 1;
+
+		simd_fill(s->data + s->len, n * patlen, pat, patlen);
+		s->len += n * patlen;
+		count -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * strbuf_add() - Append a view to a strbuf-managed string
+ *
+ * @s: The managed cstring
+ * @v: The bytes to add
+ *
+ * strbuf_append_n() with the bytes of @v, so a single memcpy(), and @v may
+ * contain NUL bytes. If @v does not fit into @s, nothing is written.
+ */
+void strbuf_add(struct strbuf *s, struct strview v)
+{
+	strbuf_append_n(s, v.data, v.len);
+}
+
+/**
+ * strbuf_cat() - Concatenate a string onto a strbuf-managed string
+ *
+ * @s: The managed cstring
+ * @b: The cstring to add
+ *
+ * strbuf_add() with a view of @b, for callers that only have a cstring.
+ *
+ * See also: strbuf_add() and strview_str()
+ */
+void strbuf_cat(struct strbuf *s, char *b)
+{
+	strbuf_add(s, strview_str(b));
+}
+
+/**
+ * strbuf_putc() - Append a single byte to a strbuf-managed string
+ *
+ * @s: The managed cstring
+ * @c: The byte to add
+ *
+ * Unlike strbuf_cat() this can also append a NUL byte. If there is no space
+ * left for @c, @s is marked as overflowed, unless it grows, see
+ * strbuf_reserve().
+ */
+void strbuf_putc(struct strbuf *s, char c)
+{
+	if (!strbuf_reserve(s, 1)) {
+		s->data[s->len] = c;
+		strbuf_commit(s, 1);
+	}
 }
 
 /**
@@ -113,7 +520,8 @@ void strbuf_clear(struct strbuf *s)
  * @size: Size of @data
  *
  * Initalise @s with @data and @size and then call strbuf_clear() to setup @s->len
- * tracking.
+ * tracking. @s does not grow beyond @size, see strbuf_alloc() for one that
+ * does.
  *
  * See also: strbuf_clear()
  */
@@ -121,6 +529,7 @@ void strbuf_init(struct strbuf *s, char *data, size_t size)
 {
 	s->data = data;
 	s->size = size;
+	s->kind = STRBUF_FIXED;
 	strbuf_clear(s);
 }
 
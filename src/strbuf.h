@@ -5,24 +5,71 @@
 // - Replacing seq_ with str_
 // - Renaming 'buffer' to 'data'
 // - Adding strbuf_cat()
+// - Adding struct strview and strbuf_add()
+// - Adding buffers that grow, see strbuf_alloc(), and ones that flush to a
+//   file descriptor, see strbuf_open(), or take memory from an arena, see
+//   strbuf_arena(), or start out on the stack, see strbuf_init_stack()
 // - Dropping some kernel-specific stuff (like WARN_ON)
 // - Dropping all functions w/o bodies in the header
 #ifndef COMMON_H
 #define COMMON_H
 
 #include <stddef.h>
+#include "arena.h"
 
 #define CHAR_WIDTH 5
-#define EXPAND_SIZE(x) x * CHAR_WIDTH
 #define min(x, y) (x < y) ? x : y
+// Size a growing strbuf starts with, unless asked for more
+#define STRBUF_MIN 64
+// Number of bytes a strbuf bound to a file descriptor collects before it
+// writes them, unless asked for another number
+#define STRBUF_FLUSH (64 << 10)
+
+// Kinds of strbuf
+#define STRBUF_FIXED 0x00
+#define STRBUF_GROW 0x01
+#define STRBUF_FD 0x02
+#define STRBUF_ARENA 0x03
+#define STRBUF_STACK 0x04
 
 struct strbuf {
 	char *data; /* The wrapped string */
 	size_t size; /* Maximum size of data */
 	size_t len; /* Current length of data */
+	int kind; /* STRBUF_*, only STRBUF_GROW and STRBUF_FD data is malloc()ed */
+	int fd; /* Where a STRBUF_FD writes data to once it is full */
+	struct arena *arena; /* Where a STRBUF_ARENA takes more room from */
 };
 
+// chars of a strview that were not counted
+#define STRVIEW_UNKNOWN ((size_t)-1)
+
+struct strview {
+	const char *data; /* The viewed bytes, not necessarily nul-terminated */
+	size_t len; /* Number of bytes in data */
+	size_t chars; /* Number of characters in data, or STRVIEW_UNKNOWN */
+};
+
+struct strview strview_bytes(const char *, size_t);
+struct strview strview_str(const char *);
+
+int strbuf_alloc(struct strbuf *, size_t);
+void strbuf_init_stack(struct strbuf *, char *, size_t);
+// strbuf, file descriptor, number of bytes to collect, 0 for STRBUF_FLUSH
+int strbuf_open(struct strbuf *, int, size_t);
+int strbuf_flush(struct strbuf *);
+// file descriptor a write() failed on
+int strbuf_retry(int);
+// strbuf, arena, number of bytes to start with
+int strbuf_arena(struct strbuf *, struct arena *, size_t);
+void strbuf_release(struct strbuf *);
+int strbuf_reserve(struct strbuf *, size_t);
+int strbuf_append_n(struct strbuf *, const char *, size_t);
+// strbuf, pattern, bytes in pattern, number of times
+int strbuf_fill(struct strbuf *, const char *, size_t, size_t);
+void strbuf_add(struct strbuf *, struct strview);
 void strbuf_cat(struct strbuf *, char *);
+void strbuf_putc(struct strbuf *, char);
 char *strbuf_str(struct strbuf *);
 size_t strbuf_get_buf(struct strbuf *, char **);
 void strbuf_clear(struct strbuf *);
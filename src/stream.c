@@ -0,0 +1,297 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "padding.h"
+#include "emit.h"
+#include "simd.h"
+#include "cache.h"
+#include "stream.h"
+
+/**
+ * struct stream - How pad_stream() pads a record
+ *
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @fill: The fill to pad with
+ * @cache: Cache of padded records, may be NULL
+ */
+struct stream {
+	int mode;
+	size_t size;
+	struct pad_fill fill;
+	struct pad_cache *cache;
+};
+
+/**
+ * stream_pad() - Add a padded record and its separator to the output
+ *
+ * @arg: The struct stream
+ * @e: The emitter
+ * @s: The record, NULL once the segments were written
+ * @len: Length of @s in bytes
+ * @sep: The separator
+ *
+ * A record found in the cache, or added to it, is a single segment,
+ * separator and all. Everything else is laid out by emit_pad().
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+static int stream_pad(void *arg, struct emitter *e, const char *s, size_t len,
+		      const char *sep)
+{
+	struct stream *st = arg;
+	const char *p;
+	size_t n;
+
+	if (!s) {
+		if (st->cache)
+			cache_release(st->cache);
+		return 0;
+	}
+
+	if (st->cache && (p = cache_pad(st->cache, st->mode, s, len, st->size,
+					&st->fill, *sep, &n)))
+		return emit(e, p, n);
+
+	return emit_pad(e, st->mode, s, len, st->size, &st->fill) ||
+	       emit(e, sep, 1);
+}
+
+/**
+ * stream_records() - Hand every record read from a file descriptor to a
+ * function
+ *
+ * @fd: The file descriptor to read from
+ * @delim: Record separator, '\n' for lines or '\0' for find -print0 output
+ * @fn: Adds a record and its separator to the emitter
+ * @arg: Passed on to @fn
+ *
+ * We read @fd in blocks of STREAM_BLOCK bytes and split them on @delim with
+ * simd_find_byte(). Every complete record is handed to @fn in place,
+ * together with its separator, so the output of a whole block is nothing but
+ * segments pointing into the input buffer and whatever @fn points them to.
+ * They are written with as few writev() calls as possible once the block is
+ * done, after which @fn is called with a NULL record. Whatever is left of a
+ * block after its last separator is moved to the front of the input buffer,
+ * so the next read() continues the record. Should a single record not fit
+ * into the input buffer, it is grown. A last record without a trailing
+ * separator is handed to @fn as well, with @delim as its separator.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int stream_records(int fd, char delim, stream_fn fn, void *arg)
+{
+	struct emitter e;
+	size_t in_size = STREAM_BLOCK;
+	size_t used = 0;
+	int ret = 1;
+
+	emit_init(&e, STDOUT_FILENO);
+
+	char *in = malloc(in_size);
+
+	if (!in) {
+		perror("pad - stream");
+		return 1;
+	}
+
+	for (;;) {
+		if (used == in_size) {
+			char *tmp = realloc(in, in_size * 2);
+
+			if (!tmp) {
+				perror("pad - stream");
+				goto out;
+			}
+
+			in = tmp;
+			in_size *= 2;
+		}
+
+		ssize_t n = read(fd, in + used, in_size - used);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("pad - stream");
+			goto out;
+		}
+
+		if (!n)
+			break;
+
+		char *start = in;
+		char *end = in + used + n;
+		char *d = in + used;
+
+		while ((d = (char *)simd_find_byte(d, end - d, delim))) {
+			if (fn(arg, &e, start, d - start, d))
+				goto out;
+			start = ++d;
+		}
+
+		// The segments point into in, which is about to change
+		if (emit_flush(&e) || fn(arg, &e, NULL, 0, NULL))
+			goto out;
+
+		used = end - start;
+		memmove(in, start, used);
+	}
+
+	if (used && fn(arg, &e, in, used, &delim))
+		goto out;
+
+	ret = emit_flush(&e);
+out:
+	free(in);
+	return ret;
+}
+
+/**
+ * stream_region() - Hand every record of a memory region to a function
+ *
+ * @s: The region, e.g. a mapped file
+ * @len: Length of @s in bytes
+ * @delim: Record separator
+ * @fn: Adds a record and its separator to the emitter
+ * @arg: Passed on to @fn
+ *
+ * Like stream_records(), but as @s stays around, segments may point into it
+ * until the very end and only @e running out of them writes anything.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int stream_region(const char *s, size_t len, char delim, stream_fn fn,
+		  void *arg)
+{
+	struct emitter e;
+	const char *end = s + len;
+	const char *d;
+
+	emit_init(&e, STDOUT_FILENO);
+
+	while ((d = simd_find_byte(s, end - s, delim))) {
+		if (fn(arg, &e, s, d - s, d))
+			return 1;
+		s = d + 1;
+	}
+
+	if (s < end && fn(arg, &e, s, end - s, &delim))
+		return 1;
+
+	return emit_flush(&e) || fn(arg, &e, NULL, 0, NULL);
+}
+
+/**
+ * pad_stream() - Pad every record read from a file descriptor
+ *
+ * @fd: The file descriptor to read from
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @padding_char: Padding character
+ * @delim: Record separator, '\n' for lines or '\0' for find -print0 output
+ * @cache: Cache of padded records for repetitive input, may be NULL
+ *
+ * Every record is padded by stream_records() in place, with the padding
+ * pointing into a shared fill block. With @cache, a record seen before is a
+ * single segment pointing into the cache, and whatever it handed out may be
+ * evicted again once the segments are written.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_stream(int fd, int mode, size_t size, char *padding_char, char delim,
+	       struct pad_cache *cache)
+{
+	struct stream st = { .mode = mode, .size = size, .cache = cache };
+
+	if (fill_init(&st.fill, padding_char, size)) {
+		perror("pad - stream");
+		return 1;
+	}
+
+	int ret = stream_records(fd, delim, stream_pad, &st);
+
+	fill_free(&st.fill);
+	return ret;
+}
+
+/**
+ * pad_region() - Pad every record of a memory region
+ *
+ * @s: The region
+ * @len: Length of @s in bytes
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @padding_char: Padding character
+ * @delim: Record separator
+ *
+ * Produces the same output as pad_stream() does for the same input.
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_region(const char *s, size_t len, int mode, size_t size,
+	       char *padding_char, char delim)
+{
+	struct stream st = { .mode = mode, .size = size };
+
+	if (fill_init(&st.fill, padding_char, size)) {
+		perror("pad - stream");
+		return 1;
+	}
+
+	int ret = stream_region(s, len, delim, stream_pad, &st);
+
+	fill_free(&st.fill);
+	return ret;
+}
+
+/**
+ * pad_stream_cached() - pad_stream() with a cache of padded records
+ *
+ * @fd: The file descriptor to read from
+ * @mode: Padding mode
+ * @size: Size of each padded record
+ * @padding_char: Padding character
+ * @delim: Record separator
+ * @records: Number of padded records to keep
+ * @stats: Print the counters of the cache to stderr once done
+ *
+ * Returns:
+ * * 0 on success
+ * * 1 on any error
+ */
+int pad_stream_cached(int fd, int mode, size_t size, char *padding_char,
+		      char delim, size_t records, int stats)
+{
+	struct pad_cache c;
+
+	if (cache_init(&c, records)) {
+		perror("pad - stream");
+		return 1;
+	}
+
+	int ret = pad_stream(fd, mode, size, padding_char, delim, &c);
+
+	if (stats)
+		cache_report(&c);
+
+	cache_free(&c);
+	return ret;
+}
@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef STREAM_H
+#define STREAM_H
+#include <stddef.h>
+#include "cache.h"
+#include "emit.h"
+
+// Size of the blocks read from the input and of the output buffer
+#define STREAM_BLOCK (1 << 20)
+
+// argument, emitter, record (NULL once the emitter was flushed), length of
+// record in bytes, its separator
+typedef int (*stream_fn)(void *, struct emitter *, const char *, size_t,
+			 const char *);
+
+// input fd, record separator, function, its argument
+int stream_records(int, char, stream_fn, void *);
+// input, length of input in bytes, record separator, function, its argument
+int stream_region(const char *, size_t, char, stream_fn, void *);
+// input fd, mode, size of result, padding, record separator, cache or NULL
+int pad_stream(int, int, size_t, char *, char, struct pad_cache *);
+// input fd, mode, size of result, padding, record separator, records to
+// cache, print hits and misses
+int pad_stream_cached(int, int, size_t, char *, char, size_t, int);
+// input, length of input in bytes, mode, size of result, padding, record
+// separator
+int pad_region(const char *, size_t, int, size_t, char *, char);
+
+#endif
@@ -32,6 +32,8 @@
 #include <wctype.h>
 
 #include "wee-utf8.h"
+#include "simd.h"
+#include "width.h"
 
 int local_utf8 = 0;
 
@@ -392,90 +394,44 @@ int utf8_char_size(const char *string)
 
 int utf8_strlen(const char *string)
 {
-	int length;
-
 	if (!string)
 		return 0;
 
-	length = 0;
-	while (string && string[0]) {
-		string = utf8_next_char(string);
-		length++;
-	}
-	return length;
+	return simd_utf8_count(string, strlen(string));
 }
 
 /*
  * Gets length of an UTF-8 string for N bytes max in string.
  *
+ * Counts the chars starting in the first N bytes (or up to the first NUL),
+ * a vector at a time, see simd_utf8_count().
+ *
  * Returns length of string (>= 0).
  */
 
 int utf8_strnlen(const char *string, int bytes)
 {
-	char *start;
-	int length;
-
-	if (!string)
+	if (!string || bytes <= 0)
 		return 0;
 
-	start = (char *)string;
-	length = 0;
-	while (string && string[0] && (string - start < bytes)) {
-		string = utf8_next_char(string);
-		length++;
-	}
-	return length;
+	return simd_utf8_count(string, strnlen(string, bytes));
 }
 
 /*
  * Gets number of chars needed on screen to display the UTF-8 string.
  *
+ * Looked up in the width table of width.c, so this neither depends on the
+ * locale nor allocates.
+ *
  * Returns the number of chars (>= 0).
  */
 
 int utf8_strlen_screen(const char *string)
 {
-	int length, num_char;
-	wchar_t *alloc_wstring, *ptr_wstring, wstring[4 + 2];
-
-	if (!string || !string[0])
+	if (!string)
 		return 0;
 
-	if (!local_utf8)
-		return utf8_strlen(string);
-
-	alloc_wstring = NULL;
-
-	if (!string[1] || !string[2] || !string[3] || !string[4]) {
-		/* optimization for max 4 chars: no malloc */
-		num_char = 4 + 1;
-		ptr_wstring = wstring;
-	} else {
-		num_char = mbstowcs(NULL, string, 0) + 1;
-		alloc_wstring =
-			malloc((num_char + 1) * sizeof(alloc_wstring[0]));
-		if (!alloc_wstring)
-			return utf8_strlen(string);
-		ptr_wstring = alloc_wstring;
-	}
-
-	if (mbstowcs(ptr_wstring, string, num_char) != (size_t)(-1)) {
-		length = wcswidth(ptr_wstring, num_char);
-		/*
-		 * if the char is non-printable, wcswidth returns -1
-		 * (for example the length of the snowman without snow (U+26C4) == -1)
-		 * => in this case, consider the length is 1, to prevent any display bug
-		 */
-		if (length < 0)
-			length = 1;
-	} else
-		length = utf8_strlen(string);
-
-	if (alloc_wstring)
-		free(alloc_wstring);
-
-	return length;
+	return utf8_width(string, strlen(string));
 }
 
 /*
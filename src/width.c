@@ -0,0 +1,181 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdint.h>
+#include <string.h>
+#include "width-table.h"
+#include "width.h"
+
+#define ONES 0x0101010101010101ULL
+#define HIGH 0x8080808080808080ULL
+
+/**
+ * codepoint_width() - Number of terminal columns of a code point
+ *
+ * @cp: The code point
+ *
+ * Looked up in the two-level table of width-table.h, see tools/gen-width.py.
+ *
+ * Returns: 0, 1 or 2
+ */
+int codepoint_width(unsigned int cp)
+{
+	if (cp >= sizeof(width_stage1) << WIDTH_BLOCK_SHIFT)
+		return 1;
+
+	const uint8_t *block = width_stage2[width_stage1[cp >> WIDTH_BLOCK_SHIFT]];
+	unsigned int i = cp & ((1 << WIDTH_BLOCK_SHIFT) - 1);
+
+	return (block[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+/**
+ * ascii_printable() - Whether eight bytes are all printable ASCII
+ *
+ * @v: The bytes
+ *
+ * Returns: Non-zero if none of them is >= 0x7f or < 0x20
+ */
+static int ascii_printable(uint64_t v)
+{
+	// Adding 1 to every byte sets the high bit of 0x7f and above, adding
+	// 0x60 that of 0x20 and above
+	return !((v | (v + ONES)) & HIGH) && !(~(v + 0x6060606060606060ULL) & HIGH);
+}
+
+/**
+ * utf8_decode() - Decode the next character of a UTF-8 string
+ *
+ * @s: The string, moved past the character
+ * @end: End of the string
+ *
+ * Neither overlong sequences nor surrogates are checked for, as nothing here
+ * relies on it.
+ *
+ * Returns:
+ * * The code point
+ * * UTF8_STRAY for a continuation byte without a start
+ * * UTF8_INVALID for a start byte without all of its continuation bytes
+ */
+unsigned int utf8_decode(const char **s, const char *end)
+{
+	const unsigned char *p = (const unsigned char *)*s;
+	const unsigned char *e = (const unsigned char *)end;
+	unsigned int c = *p++;
+
+	if (c < 0xc0) {
+		*s = (const char *)p;
+		return (c < 0x80) ? c : UTF8_STRAY;
+	}
+
+	int n = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : 1;
+	unsigned int cp = c & (0x3f >> n);
+	int i;
+
+	for (i = 0; i < n && p < e && (*p & 0xc0) == 0x80; ++i)
+		cp = (cp << 6) | (*p++ & 0x3f);
+
+	*s = (const char *)p;
+	return (i == n) ? cp : UTF8_INVALID;
+}
+
+/**
+ * ascii_span() - Length of the printable ASCII a string starts with
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ *
+ * Taken eight bytes at a time as long as there are as many.
+ *
+ * Returns: Number of bytes of @s before the first one that is >= 0x7f or < 0x20
+ */
+size_t ascii_span(const char *s, size_t len)
+{
+	size_t i = 0;
+
+	for (; len - i >= 8; i += 8) {
+		uint64_t v;
+
+		memcpy(&v, s + i, 8);
+		if (!ascii_printable(v))
+			break;
+	}
+
+	while (i < len && s[i] >= 0x20 && s[i] < 0x7f)
+		++i;
+
+	return i;
+}
+
+/**
+ * utf8_width_prefix() - Longest start of a UTF-8 string within some columns
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ * @max: Number of columns the start may take
+ * @width: Set to the number of columns it takes
+ *
+ * Goes through @s once, front to back, and stops at the first character that
+ * does not fit any more, so a cut always falls between two characters.
+ * Characters without columns right after the last one that fits are kept.
+ * Runs of printable ASCII are skipped with ascii_span(). Control characters
+ * take no columns. A byte that does not start a valid sequence takes one
+ * column, a stray continuation byte none, like simd_utf8_count() does not
+ * count it.
+ *
+ * Returns: Length of the start in bytes, @len if all of @s fits
+ */
+size_t utf8_width_prefix(const char *s, size_t len, size_t max, size_t *width)
+{
+	const char *p = s;
+	const char *end = s + len;
+	size_t w = 0;
+
+	while (p < end) {
+		size_t room = max - w;
+
+		if ((size_t)(end - p) < room)
+			room = end - p;
+
+		size_t n = ascii_span(p, room);
+
+		w += n;
+		p += n;
+		if (p == end)
+			break;
+
+		const char *q = p;
+		unsigned int cp = utf8_decode(&q, end);
+		// Out of range for the table, so an invalid sequence takes one
+		size_t cols = (cp == UTF8_STRAY) ? 0 : codepoint_width(cp);
+
+		if (cols > max - w)
+			break;
+
+		w += cols;
+		p = q;
+	}
+
+	*width = w;
+	return p - s;
+}
+
+/**
+ * utf8_width() - Number of terminal columns of a UTF-8 string
+ *
+ * @s: The string
+ * @len: Length of @s in bytes
+ *
+ * Unlike utf8_strlen_screen() used to, this neither depends on the locale nor
+ * allocates, see utf8_width_prefix().
+ *
+ * Returns: The number of columns
+ */
+size_t utf8_width(const char *s, size_t len)
+{
+	size_t width;
+
+	utf8_width_prefix(s, len, SIZE_MAX, &width);
+	return width;
+}
@@ -0,0 +1,24 @@
+// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef WIDTH_H
+#define WIDTH_H
+#include <stddef.h>
+
+// What utf8_decode() returns for bytes that are not a character, both above
+// the last code point
+#define UTF8_STRAY 0x110000
+#define UTF8_INVALID 0x110001
+
+// code point
+int codepoint_width(unsigned int);
+// string, length of string in bytes
+size_t ascii_span(const char *, size_t);
+size_t utf8_width(const char *, size_t);
+// string, length of string in bytes, columns, set to the columns taken
+size_t utf8_width_prefix(const char *, size_t, size_t, size_t *);
+// string, moved past the character, end of string
+unsigned int utf8_decode(const char **, const char *);
+
+#endif
@@ -0,0 +1,106 @@
+#!/usr/bin/env perl
+# SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Generates src/grapheme-table.h, the Grapheme_Cluster_Break property of every
+# code point, from the Unicode database Perl was built with:
+#
+#	make grapheme-table
+#
+# Unlike gen-width.py this is Perl, as the unicodedata module of Python does
+# not know the property. Extended_Pictographic is folded into it as one more
+# value, which Perl's Unicode::UCD does already, as none of these code points
+# has a value other than Other.
+#
+# The table has two levels like the one of gen-width.py, with 4 bits per code
+# point.
+
+use strict;
+use warnings;
+use Unicode::UCD qw(prop_invmap);
+
+use constant BLOCK => 256;
+use constant PLANES => 0x110000;
+
+# In the order of enum grapheme_prop
+my @PROPS = qw(
+	Other CR LF Control Extend ZWJ Regional_Indicator Prepend SpacingMark
+	L V T LV LVT ExtPict_XX
+);
+
+my @NAMES = qw(
+	GB_OTHER GB_CR GB_LF GB_CONTROL GB_EXTEND GB_ZWJ GB_RI GB_PREPEND
+	GB_SPACINGMARK GB_L GB_V GB_T GB_LV GB_LVT GB_EXTPICT
+);
+
+my %value;
+@value{@PROPS} = (0 .. $#PROPS);
+
+my ($list, $map) = prop_invmap('GCB');
+my @prop = (0) x PLANES;
+
+for my $i (0 .. $#$list) {
+	my $hi = ($i < $#$list) ? $list->[$i + 1] - 1 : PLANES - 1;
+	my $v = $value{$map->[$i]};
+
+	die "gen-grapheme.pl: unknown value $map->[$i]\n" unless defined $v;
+	@prop[$list->[$i] .. $hi] = ($v) x ($hi - $list->[$i] + 1);
+}
+
+my (@blocks, %index, @stage1);
+
+for (my $base = 0; $base < PLANES; $base += BLOCK) {
+	my $packed = '';
+
+	for (my $i = 0; $i < BLOCK; $i += 2) {
+		$packed .= chr($prop[$base + $i] | $prop[$base + $i + 1] << 4);
+	}
+
+	unless (exists $index{$packed}) {
+		$index{$packed} = scalar @blocks;
+		push @blocks, $packed;
+	}
+	push @stage1, $index{$packed};
+}
+
+die "gen-grapheme.pl: too many blocks for uint8_t\n" if @blocks > 256;
+
+print "// SPDX-FileCopyrightText: 2024 zocker <zocker\@10zen.eu>\n";
+print "//\n";
+print "// SPDX-License-Identifier: GPL-2.0-or-later\n\n";
+printf "// Generated by tools/gen-grapheme.pl from Unicode %s, do not edit\n\n",
+	Unicode::UCD::UnicodeVersion();
+print "#ifndef GRAPHEME_TABLE_H\n#define GRAPHEME_TABLE_H\n";
+print "#include <stdint.h>\n\n";
+print "#define GRAPHEME_BLOCK_SHIFT 8\n";
+printf "#define GRAPHEME_BLOCKS %d\n\n", scalar @blocks;
+
+print "// Grapheme_Cluster_Break, and Extended_Pictographic\n";
+print "enum grapheme_prop {\n";
+print "\t$_,\n" for @NAMES;
+print "};\n\n";
+
+print "// Block of every 256 code points\n";
+printf "static const uint8_t grapheme_stage1[%d] = {\n", scalar @stage1;
+for (my $i = 0; $i < @stage1; $i += 16) {
+	my $hi = ($i + 15 < $#stage1) ? $i + 15 : $#stage1;
+
+	print "\t", join(', ', @stage1[$i .. $hi]), ",\n";
+}
+print "};\n\n";
+
+print "// Property of every code point of a block, 4 bits each\n";
+printf "static const uint8_t grapheme_stage2[GRAPHEME_BLOCKS][%d] = {\n",
+	BLOCK / 2;
+for my $packed (@blocks) {
+	my @bytes = unpack('C*', $packed);
+
+	print "\t{\n";
+	for (my $i = 0; $i < @bytes; $i += 8) {
+		print "\t\t", join(', ', map { sprintf '0x%02x', $_ }
+				       @bytes[$i .. $i + 7]), ",\n";
+	}
+	print "\t},\n";
+}
+print "};\n\n#endif\n";
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Generates src/width-table.h, the number of terminal columns of every code
+# point, from the Unicode database Python was built with:
+#
+#	make width-table
+#
+# 0 for combining marks, format and control characters and Hangul jamo
+# vowels and finals, 2 for East Asian Wide and Fullwidth characters (and the
+# unassigned code points of the CJK blocks, which default to wide), 1 for
+# everything else, including the format characters that are printed, like
+# the Arabic number sign. This is what wcwidth() does, without the locale.
+#
+# The table has two levels: the upper bits of a code point pick one of the
+# distinct blocks of 256 code points, which hold 2 bits per code point.
+
+import sys
+import unicodedata
+
+BLOCK = 256
+PLANES = 0x110000
+
+WIDE_DEFAULT = (
+	(0x3400, 0x4DBF),
+	(0x4E00, 0x9FFF),
+	(0xF900, 0xFAFF),
+	(0x20000, 0x2FFFD),
+	(0x30000, 0x3FFFD),
+)
+
+
+# Prepended_Concatenation_Mark, format characters that take a column
+PRINTED_FORMAT = (
+	(0x0600, 0x0605),
+	(0x06DD, 0x06DD),
+	(0x070F, 0x070F),
+	(0x0890, 0x0891),
+	(0x08E2, 0x08E2),
+	(0x110BD, 0x110BD),
+	(0x110CD, 0x110CD),
+)
+
+# Hangul jamo that join the syllable before them
+HANGUL_JOINING = (
+	(0x1160, 0x11FF),
+	(0xD7B0, 0xD7FF),
+)
+
+
+def within(cp, ranges):
+	return any(lo <= cp <= hi for lo, hi in ranges)
+
+
+def width(cp):
+	c = chr(cp)
+	cat = unicodedata.category(c)
+
+	if cp == 0x00AD or within(cp, PRINTED_FORMAT):
+		return 1
+	if cat in ('Mn', 'Me', 'Cf', 'Cc') or within(cp, HANGUL_JOINING):
+		return 0
+	if cat == 'Cs':
+		return 1
+	if unicodedata.east_asian_width(c) in ('W', 'F'):
+		return 2
+	if cat == 'Cn' and within(cp, WIDE_DEFAULT):
+		return 2
+	return 1
+
+
+def main():
+	blocks = []
+	index = {}
+	stage1 = []
+
+	for base in range(0, PLANES, BLOCK):
+		packed = bytearray(BLOCK // 4)
+
+		for i in range(BLOCK):
+			packed[i // 4] |= width(base + i) << (i % 4 * 2)
+
+		packed = bytes(packed)
+		if packed not in index:
+			index[packed] = len(blocks)
+			blocks.append(packed)
+		stage1.append(index[packed])
+
+	if len(blocks) > 256:
+		sys.exit('gen-width.py: too many blocks for uint8_t')
+
+	out = sys.stdout
+	out.write('// SPDX-FileCopyrightText: 2024 zocker <zocker@10zen.eu>\n')
+	out.write('//\n')
+	out.write('// SPDX-License-Identifier: GPL-2.0-or-later\n\n')
+	out.write('// Generated by tools/gen-width.py from Unicode %s, do not '
+		  'edit\n\n' % unicodedata.unidata_version)
+	out.write('#ifndef WIDTH_TABLE_H\n#define WIDTH_TABLE_H\n')
+	out.write('#include <stdint.h>\n\n')
+	out.write('#define WIDTH_BLOCK_SHIFT 8\n')
+	out.write('#define WIDTH_BLOCKS %d\n\n' % len(blocks))
+
+	out.write('// Block of every 256 code points\n')
+	out.write('static const uint8_t width_stage1[%d] = {\n' % len(stage1))
+	for i in range(0, len(stage1), 16):
+		out.write('\t' + ', '.join('%d' % b for b in stage1[i:i + 16]) +
+			  ',\n')
+	out.write('};\n\n')
+
+	out.write('// Columns of every code point of a block, 2 bits each\n')
+	out.write('static const uint8_t width_stage2[WIDTH_BLOCKS][%d] = {\n' %
+		  (BLOCK // 4))
+	for packed in blocks:
+		out.write('\t{\n')
+		for i in range(0, len(packed), 8):
+			out.write('\t\t' + ', '.join('0x%02x' % b
+						    for b in packed[i:i + 8]) +
+				  ',\n')
+		out.write('\t},\n')
+	out.write('};\n\n#endif\n')
+
+
+if __name__ == '__main__':
+	main()